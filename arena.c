@@ -0,0 +1,88 @@
+/* Chunked bump allocator layered on top of test_malloc */
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "arena.h"
+#include "harness.h"
+
+#define ARENA_ALIGN sizeof(void *)
+
+/* Header at the beginning of every chunk */
+struct __arena_chunk {
+    struct __arena_chunk *next;
+};
+
+/* Get a chunk able to hold at least size bytes */
+static bool arena_grow(arena_t *a, size_t size)
+{
+    size_t chunk_size = sizeof(arena_chunk_t) + size;
+    if (chunk_size < ARENA_CHUNK_SIZE)
+        chunk_size = ARENA_CHUNK_SIZE;
+
+    arena_chunk_t *chunk = test_malloc(chunk_size);
+    if (!chunk)
+        return false;
+
+    chunk->next = a->chunks;
+    a->chunks = chunk;
+    a->cur = (char *) (chunk + 1);
+    a->end = (char *) chunk + chunk_size;
+    return true;
+}
+
+bool arena_init(arena_t *a)
+{
+    a->chunks = NULL;
+    a->cur = a->end = NULL;
+    return arena_grow(a, 0);
+}
+
+void *arena_alloc(arena_t *a, size_t size)
+{
+    size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+    bool grow = (size_t) (a->end - a->cur) < size;
+
+    /* Apply noallocate mode and failure injection to every block. A block
+     * from a new chunk went through them in test_malloc already.
+     */
+    if (grow ? !arena_grow(a, size) : !test_malloc_permitted())
+        return NULL;
+
+    void *p = a->cur;
+    a->cur += size;
+    return p;
+}
+
+void arena_steal(arena_t *to, arena_t *from)
+{
+    if (!from->chunks)
+        return;
+
+    arena_chunk_t *last = from->chunks;
+    while (last->next)
+        last = last->next;
+
+    /* Keep the newest chunk of to in front, so that its tail is still used */
+    if (to->chunks) {
+        last->next = to->chunks->next;
+        to->chunks->next = from->chunks;
+    } else {
+        to->chunks = from->chunks;
+        to->cur = from->cur;
+        to->end = from->end;
+    }
+
+    from->chunks = NULL;
+    from->cur = from->end = NULL;
+}
+
+void arena_release(arena_t *a)
+{
+    while (a->chunks) {
+        arena_chunk_t *next = a->chunks->next;
+        test_free(a->chunks);
+        a->chunks = next;
+    }
+    a->cur = a->end = NULL;
+}
@@ -0,0 +1,38 @@
+#ifndef LAB0_ARENA_H
+#define LAB0_ARENA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Chunked bump allocator owned by a single queue.
+ *
+ * Blocks are carved out of chunks obtained from test_malloc and are never
+ * returned one by one: arena_release() drops all chunks at once, so freeing
+ * the storage of a queue costs one test_free per chunk instead of one or two
+ * per element.
+ */
+
+#define ARENA_CHUNK_SIZE (64 * 1024)
+
+typedef struct __arena_chunk arena_chunk_t;
+
+typedef struct {
+    arena_chunk_t *chunks; /* newest chunk first */
+    char *cur, *end;       /* unused tail of the newest chunk */
+} arena_t;
+
+/* Initialize an empty arena and reserve its first chunk.
+ * Return false if test_malloc fails.
+ */
+bool arena_init(arena_t *a);
+
+/* Allocate a block of size bytes. Return NULL if allocation fails */
+void *arena_alloc(arena_t *a, size_t size);
+
+/* Move every chunk of arena from to arena to, leaving from empty */
+void arena_steal(arena_t *to, arena_t *from);
+
+/* Release every chunk of the arena */
+void arena_release(arena_t *a);
+
+#endif /* LAB0_ARENA_H */
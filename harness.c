@@ -43,6 +43,11 @@ typedef struct __block_element {
 static block_element_t *allocated = NULL;
 static size_t allocated_count = 0;
 
+/* Counters of allocation_stats() */
+static size_t allocated_bytes = 0;
+static size_t peak_bytes = 0;
+static size_t handed_out = 0;
+
 /* Percent probability of malloc failure */
 int fail_probability = 0;
 
@@ -117,18 +122,37 @@ static size_t *find_footer(block_element_t *b)
 
 /* Implementation of application functions */
 
-void *test_malloc(size_t size)
+bool test_malloc_permitted()
 {
     if (noallocate_mode) {
         report_event(MSG_FATAL, "Calls to malloc disallowed");
-        return NULL;
+        return false;
     }
 
     if (fail_allocation()) {
         report_event(MSG_WARN, "Malloc returning NULL");
-        return NULL;
+        return false;
+    }
+
+    handed_out++;
+    return true;
+}
+
+bool test_free_permitted()
+{
+    if (noallocate_mode) {
+        report_event(MSG_FATAL, "Calls to free disallowed");
+        return false;
     }
 
+    return true;
+}
+
+void *test_malloc(size_t size)
+{
+    if (!test_malloc_permitted())
+        return NULL;
+
     block_element_t *new_block =
         malloc(size + sizeof(block_element_t) + sizeof(size_t));
     if (!new_block) {
@@ -152,6 +176,9 @@ void *test_malloc(size_t size)
         allocated->prev = new_block;
     allocated = new_block;
     allocated_count++;
+    allocated_bytes += size;
+    if (allocated_bytes > peak_bytes)
+        peak_bytes = allocated_bytes;
 
     return p;
 }
@@ -170,10 +197,8 @@ void *test_calloc(size_t nelem, size_t elsize)
 
 void test_free(void *p)
 {
-    if (noallocate_mode) {
-        report_event(MSG_FATAL, "Calls to free disallowed");
+    if (!test_free_permitted())
         return;
-    }
 
     if (!p)
         return;
@@ -201,6 +226,7 @@ void test_free(void *p)
     if (bn)
         bn->prev = bp;
 
+    allocated_bytes -= b->payload_size;
     free(b);
     allocated_count--;
 }
@@ -221,6 +247,15 @@ size_t allocation_check()
     return allocated_count;
 }
 
+void allocation_stats(size_t *bytes, size_t *peak, size_t *blocks)
+{
+    *bytes = allocated_bytes;
+    *peak = peak_bytes;
+    *blocks = handed_out;
+    peak_bytes = allocated_bytes;
+    handed_out = 0;
+}
+
 /* Implementation of functions for testing */
 
 /* Set/unset cautious mode.
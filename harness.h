@@ -16,11 +16,23 @@ void test_free(void *p);
 char *test_strdup(const char *s);
 /* FIXME: provide test_realloc as well */
 
+/* Allocators that carve blocks out of memory obtained from test_malloc call
+ * these before handing out or taking back each block, so that noallocate
+ * mode and malloc failure injection still apply to every block.
+ */
+bool test_malloc_permitted();
+bool test_free_permitted();
+
 #ifdef INTERNAL
 
 /* Report number of allocated blocks */
 size_t allocation_check();
 
+/* Report bytes in allocated blocks, the most of them since the last call, and
+ * the number of blocks handed out since then, then start counting anew
+ */
+void allocation_stats(size_t *bytes, size_t *peak, size_t *blocks);
+
 /* Probability of malloc failing, expressed as percent */
 extern int fail_probability;
 
@@ -0,0 +1,530 @@
+/* Merge sorts on Linux-like doubly-linked lists */
+
+#include <stdbool.h>
+
+#include "list_sort.h"
+
+/* Merge two NULL-terminated singly-linked lists, leaving prev links broken.
+ * On ties, nodes from a come first.
+ */
+static struct list_head *merge(void *priv,
+                               list_cmp_func_t cmp,
+                               struct list_head *a,
+                               struct list_head *b)
+{
+    struct list_head *head = NULL, **tail = &head;
+
+    for (;;) {
+        if (cmp(priv, a, b) <= 0) {
+            *tail = a;
+            tail = &a->next;
+            a = a->next;
+            if (!a) {
+                *tail = b;
+                break;
+            }
+        } else {
+            *tail = b;
+            tail = &b->next;
+            b = b->next;
+            if (!b) {
+                *tail = a;
+                break;
+            }
+        }
+    }
+    return head;
+}
+
+/* Do the final merge onto head, restoring the prev links on the way */
+static void merge_final(void *priv,
+                        list_cmp_func_t cmp,
+                        struct list_head *head,
+                        struct list_head *a,
+                        struct list_head *b)
+{
+    struct list_head *tail = head;
+
+    for (;;) {
+        if (cmp(priv, a, b) <= 0) {
+            tail->next = a;
+            a->prev = tail;
+            tail = a;
+            a = a->next;
+            if (!a)
+                break;
+        } else {
+            tail->next = b;
+            b->prev = tail;
+            tail = b;
+            b = b->next;
+            if (!b) {
+                b = a;
+                break;
+            }
+        }
+    }
+
+    /* Link the remainder of b onto tail */
+    tail->next = b;
+    do {
+        b->prev = tail;
+        tail = b;
+        b = b->next;
+    } while (b);
+
+    tail->next = head;
+    head->prev = tail;
+}
+
+/* Do the final merge onto head like merge_final(), but drop every node equal
+ * to another one as it comes out, so that each string is kept only if unique.
+ * Return the number of nodes dropped.
+ */
+static size_t merge_final_unique(void *priv,
+                                 list_cmp_func_t cmp,
+                                 list_drop_func_t drop,
+                                 struct list_head *head,
+                                 struct list_head *a,
+                                 struct list_head *b)
+{
+    struct list_head *tail = head;
+    size_t dropped = 0;
+    bool dup = false; /* tail has an equal node dropped after it */
+
+    while (a || b) {
+        struct list_head *node;
+        if (!b || (a && cmp(priv, a, b) <= 0)) {
+            node = a;
+            a = a->next;
+        } else {
+            node = b;
+            b = b->next;
+        }
+
+        if (tail != head && !cmp(priv, tail, node)) {
+            drop(node);
+            dropped++;
+            dup = true;
+            continue;
+        }
+        if (dup) {
+            struct list_head *prev = tail->prev;
+            drop(tail);
+            dropped++;
+            tail = prev;
+            dup = false;
+        }
+        tail->next = node;
+        node->prev = tail;
+        tail = node;
+    }
+    if (dup) {
+        struct list_head *prev = tail->prev;
+        drop(tail);
+        dropped++;
+        tail = prev;
+    }
+
+    tail->next = head;
+    head->prev = tail;
+    return dropped;
+}
+
+/* Sort the NULL-terminated list into pending sublists, and merge them all but
+ * the final merge, whose inputs are returned and left in *last.
+ */
+static struct list_head *merge_pending(void *priv,
+                                       list_cmp_func_t cmp,
+                                       struct list_head *list,
+                                       struct list_head **last)
+{
+    struct list_head *pending = NULL;
+    size_t count = 0; /* Count of pending nodes */
+
+    /* Each bit k of count tells whether a sublist of size 2^k is pending.
+     * Adding a node increments count; when that carries past bit k, the two
+     * sublists of size 2^k below it are merged, so that pending sublists keep
+     * decreasing in size and no merge is worse than 2:1.
+     */
+    do {
+        size_t bits;
+        struct list_head **tail = &pending;
+
+        /* Find the least-significant clear bit in count */
+        for (bits = count; bits & 1; bits >>= 1)
+            tail = &(*tail)->prev;
+        /* Do the indicated merge */
+        if (bits) {
+            struct list_head *a = *tail, *b = a->prev;
+
+            a = merge(priv, cmp, b, a);
+            /* Install the merged result in place of the inputs */
+            a->prev = b->prev;
+            *tail = a;
+        }
+
+        /* Move one element from input list to pending */
+        list->prev = pending;
+        pending = list;
+        list = list->next;
+        pending->next = NULL;
+        count++;
+    } while (list);
+
+    /* End of input; merge together all the pending lists */
+    list = pending;
+    pending = pending->prev;
+    for (;;) {
+        struct list_head *next = pending->prev;
+
+        if (!next)
+            break;
+        list = merge(priv, cmp, pending, list);
+        pending = next;
+    }
+
+    *last = list;
+    return pending;
+}
+
+void list_sort(void *priv, struct list_head *head, list_cmp_func_t cmp)
+{
+    struct list_head *list = head->next, *last;
+
+    /* Zero or one element */
+    if (list == head->prev)
+        return;
+
+    /* Convert to a NULL-terminated singly-linked list */
+    head->prev->next = NULL;
+    list = merge_pending(priv, cmp, list, &last);
+
+    /* The final merge, rebuilding prev links */
+    merge_final(priv, cmp, head, list, last);
+}
+
+size_t list_sort_unique(void *priv,
+                        struct list_head *head,
+                        list_cmp_func_t cmp,
+                        list_drop_func_t drop)
+{
+    struct list_head *list = head->next, *last;
+
+    /* Zero or one element */
+    if (list == head->prev)
+        return 0;
+
+    head->prev->next = NULL;
+    list = merge_pending(priv, cmp, list, &last);
+    return merge_final_unique(priv, cmp, drop, head, list, last);
+}
+
+/* A sorted run, kept as a NULL-terminated singly-linked list */
+struct run {
+    struct list_head *head, *tail;
+    size_t len;
+};
+
+/* Enough for 2^64 elements, since run lengths grow at least like Fibonacci
+ * numbers from the bottom of the stack to its top.
+ */
+#define MAX_PENDING_RUNS 96
+
+/* Number of consecutive wins of one run before a merge starts to gallop */
+#define MIN_GALLOP 7
+
+/* Shorter natural runs are extended to this length */
+#define MIN_RUN 32
+
+/* Number of short natural runs in a row at the start of the input after which
+ * it is taken for random and the rest is left to list_sort()
+ */
+#define MAX_SHORT_RUNS 8
+
+/* Split the next run off list, reversing it if it is strictly descending.
+ * The length of the natural run, before any extension, is stored in natural.
+ */
+static struct list_head *find_run(void *priv,
+                                  list_cmp_func_t cmp,
+                                  struct list_head *list,
+                                  struct run *run,
+                                  size_t *natural)
+{
+    struct list_head *tail = list, *next = list->next;
+    size_t len = 1;
+
+    if (next && cmp(priv, tail, next) > 0) {
+        /* Strictly descending: reverse while scanning */
+        tail->next = NULL;
+        do {
+            struct list_head *tmp = next->next;
+            next->next = tail;
+            tail = next;
+            next = tmp;
+            len++;
+        } while (next && cmp(priv, tail, next) > 0);
+        run->head = tail;
+        run->tail = list;
+    } else {
+        while (next && cmp(priv, tail, next) <= 0) {
+            tail = next;
+            next = next->next;
+            len++;
+        }
+        tail->next = NULL;
+        run->head = list;
+        run->tail = tail;
+    }
+
+    run->len = *natural = len;
+
+    /* Extend a short run to MIN_RUN nodes by binary insertion, so that random
+     * input does not turn into a lot of tiny merges. The run is laid out in
+     * an array meanwhile, which makes the binary search cheap.
+     */
+    if (next && len < MIN_RUN) {
+        struct list_head *nodes[MIN_RUN];
+        struct list_head *node = run->head;
+        for (size_t i = 0; i < len; i++, node = node->next)
+            nodes[i] = node;
+
+        for (; next && len < MIN_RUN; len++) {
+            node = next;
+            next = next->next;
+
+            /* Find the first node greater than node, to keep it stable */
+            size_t lo = 0, hi = len;
+            while (lo < hi) {
+                size_t mid = lo + (hi - lo) / 2;
+                if (cmp(priv, nodes[mid], node) > 0)
+                    hi = mid;
+                else
+                    lo = mid + 1;
+            }
+            for (size_t i = len; i > lo; i--)
+                nodes[i] = nodes[i - 1];
+            nodes[lo] = node;
+        }
+
+        for (size_t i = 0; i + 1 < len; i++)
+            nodes[i]->next = nodes[i + 1];
+        nodes[len - 1]->next = NULL;
+        run->head = nodes[0];
+        run->tail = nodes[len - 1];
+        run->len = len;
+    }
+    return next;
+}
+
+/* Walk at most n nodes forward from node, stopping at the last node */
+static struct list_head *walk(struct list_head *node, size_t n, size_t *moved)
+{
+    size_t i = 0;
+    for (; i < n && node->next; i++)
+        node = node->next;
+    *moved = i;
+    return node;
+}
+
+/* Whether node can be taken before key when merging */
+static inline bool precedes(void *priv,
+                            list_cmp_func_t cmp,
+                            const struct list_head *node,
+                            const struct list_head *key,
+                            bool strict)
+{
+    int c = cmp(priv, node, key);
+    return strict ? c < 0 : c <= 0;
+}
+
+/* Given that node precedes key, find the last node of its list that does.
+ * The search steps forward 1, 2, 4, ... nodes and then halves the last gap,
+ * so it needs O(log k) comparisons to skip k nodes.
+ */
+static struct list_head *gallop(void *priv,
+                                list_cmp_func_t cmp,
+                                struct list_head *node,
+                                const struct list_head *key,
+                                bool strict)
+{
+    size_t step = 1, gap, moved;
+
+    for (;;) {
+        struct list_head *probe = walk(node, step, &moved);
+        if (!moved)
+            return node;
+        if (!precedes(priv, cmp, probe, key, strict)) {
+            gap = moved;
+            break;
+        }
+        node = probe;
+        if (moved < step)
+            return node;
+        step <<= 1;
+    }
+
+    /* node precedes key, and the node gap steps further does not */
+    while (gap > 1) {
+        size_t half = gap / 2;
+        struct list_head *probe = walk(node, half, &moved);
+        if (precedes(priv, cmp, probe, key, strict)) {
+            node = probe;
+            gap -= half;
+        } else {
+            gap = half;
+        }
+    }
+    return node;
+}
+
+/* Merge run b, which comes right after run a, into run a */
+static void merge_runs(void *priv,
+                       list_cmp_func_t cmp,
+                       struct run *a,
+                       struct run *b)
+{
+    struct list_head *x = a->head, *y = b->head;
+    struct list_head *head = NULL, **tail = &head, *last;
+    int x_wins = 0, y_wins = 0;
+
+    /* Runs that do not overlap are simply concatenated */
+    if (cmp(priv, a->tail, y) <= 0) {
+        a->tail->next = y;
+        a->tail = b->tail;
+        a->len += b->len;
+        return;
+    }
+    if (cmp(priv, b->tail, x) < 0) {
+        b->tail->next = x;
+        a->head = y;
+        a->len += b->len;
+        return;
+    }
+
+    while (x && y) {
+        if (cmp(priv, x, y) <= 0) {
+            last = x;
+            if (++x_wins > MIN_GALLOP) {
+                /* a keeps winning: take all its nodes before y at once */
+                last = gallop(priv, cmp, x, y, false);
+                x_wins = 0;
+            }
+            *tail = x;
+            tail = &last->next;
+            x = last->next;
+            y_wins = 0;
+        } else {
+            last = y;
+            if (++y_wins > MIN_GALLOP) {
+                /* b keeps winning: take all its nodes strictly before x */
+                last = gallop(priv, cmp, y, x, true);
+                y_wins = 0;
+            }
+            *tail = y;
+            tail = &last->next;
+            y = last->next;
+            x_wins = 0;
+        }
+    }
+
+    if (x) {
+        *tail = x;
+    } else {
+        *tail = y;
+        a->tail = b->tail;
+    }
+    a->head = head;
+    a->len += b->len;
+}
+
+/* Merge the runs at index k and k + 1 of the stack */
+static void merge_at(void *priv,
+                     list_cmp_func_t cmp,
+                     struct run *runs,
+                     size_t *nr_runs,
+                     size_t k)
+{
+    merge_runs(priv, cmp, &runs[k], &runs[k + 1]);
+    for (size_t i = k + 1; i + 1 < *nr_runs; i++)
+        runs[i] = runs[i + 1];
+    (*nr_runs)--;
+}
+
+/* Restore the Timsort invariants on the run stack:
+ *   len[i - 2] > len[i - 1] + len[i] and len[i - 1] > len[i]
+ */
+static void merge_collapse(void *priv,
+                           list_cmp_func_t cmp,
+                           struct run *runs,
+                           size_t *nr_runs)
+{
+    while (*nr_runs > 1) {
+        size_t n = *nr_runs - 2;
+        if ((n > 0 && runs[n - 1].len <= runs[n].len + runs[n + 1].len) ||
+            (n > 1 && runs[n - 2].len <= runs[n - 1].len + runs[n].len)) {
+            if (runs[n - 1].len < runs[n + 1].len)
+                n--;
+        } else if (runs[n].len > runs[n + 1].len) {
+            break;
+        }
+        merge_at(priv, cmp, runs, nr_runs, n);
+    }
+}
+
+void list_sort_adaptive(void *priv, struct list_head *head, list_cmp_func_t cmp)
+{
+    struct run runs[MAX_PENDING_RUNS];
+    size_t nr_runs = 0;
+    struct list_head *list = head->next;
+
+    /* Zero or one element */
+    if (list == head->prev)
+        return;
+
+    /* Convert to a NULL-terminated singly-linked list */
+    head->prev->next = NULL;
+
+    size_t short_runs = 0;
+    bool probing = true;
+    do {
+        size_t natural;
+        list = find_run(priv, cmp, list, &runs[nr_runs++], &natural);
+        merge_collapse(priv, cmp, runs, &nr_runs);
+
+        if (probing) {
+            if (natural >= MIN_RUN)
+                probing = false; /* some order in the input, stay adaptive */
+            else if (++short_runs == MAX_SHORT_RUNS)
+                break;
+        }
+    } while (list);
+
+    if (list) {
+        /* The input looks random, where list_sort() is faster, not least
+         * because it rebuilds prev links within its final merge. Chain the
+         * runs found so far back in front of the rest and hand everything
+         * over to it.
+         */
+        for (size_t i = 0; i < nr_runs; i++)
+            runs[i].tail->next = i + 1 < nr_runs ? runs[i + 1].head : list;
+        head->next = runs[0].head;
+        list_sort(priv, head, cmp);
+        return;
+    }
+
+    /* Merge whatever is left, from the top of the stack down */
+    while (nr_runs > 1)
+        merge_at(priv, cmp, runs, &nr_runs, nr_runs - 2);
+
+    /* Rebuild prev links and close the list onto head */
+    struct list_head *prev = head;
+    for (list = runs[0].head; list; list = list->next) {
+        list->prev = prev;
+        prev->next = list;
+        prev = list;
+    }
+    prev->next = head;
+    head->prev = prev;
+}
+
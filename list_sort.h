@@ -0,0 +1,70 @@
+#ifndef LAB0_LIST_SORT_H
+#define LAB0_LIST_SORT_H
+
+#include "list.h"
+
+/**
+ * list_cmp_func_t - Comparison function used by list_sort()
+ * @priv: private data passed through from list_sort()
+ * @a: first node to compare
+ * @b: second node to compare
+ *
+ * Return: negative or zero if @a should sort before @b, positive otherwise.
+ * Only the sign matters: a two-way comparison (returning 0 or 1) is enough.
+ */
+typedef int (*list_cmp_func_t)(void *priv,
+                               const struct list_head *a,
+                               const struct list_head *b);
+
+/* Release a node dropped from its list by list_sort_unique() */
+typedef void (*list_drop_func_t)(struct list_head *node);
+
+/**
+ * list_sort() - Sort a list
+ * @priv: private data, opaque to list_sort(), passed to @cmp
+ * @head: the list to sort
+ * @cmp: the elements comparison function
+ *
+ * The sort is a stable, bottom-up merge sort modeled after lib/list_sort.c in
+ * the Linux kernel. It neither recurses nor allocates: sorted sublists wait in
+ * a "pending" list linked through their prev pointers, and two of them of size
+ * 2^k are merged as soon as a third one follows, which keeps merges at most
+ * 2:1 unbalanced. This needs n*log2(n) - 1.2*n comparisons on average.
+ */
+void list_sort(void *priv, struct list_head *head, list_cmp_func_t cmp);
+
+/**
+ * list_sort_unique() - Sort a list, dropping the nodes which are not unique
+ * @priv: private data, opaque to list_sort_unique(), passed to @cmp
+ * @head: the list to sort
+ * @cmp: the elements comparison function, which must return 0 for equal nodes
+ * @drop: called on each node dropped, once it is off the list
+ *
+ * Like list_sort(), but the final merge also compares each node it links with
+ * the one before, and drops every group of equal nodes, so that only the nodes
+ * equal to no other one are left in order. It saves a second walk of the list.
+ *
+ * Return: the number of nodes dropped.
+ */
+size_t list_sort_unique(void *priv,
+                        struct list_head *head,
+                        list_cmp_func_t cmp,
+                        list_drop_func_t drop);
+
+/**
+ * list_sort_adaptive() - Sort a list, taking advantage of existing order
+ * @priv: private data, opaque to list_sort_adaptive(), passed to @cmp
+ * @head: the list to sort
+ * @cmp: the elements comparison function
+ *
+ * A stable natural merge sort in the spirit of Timsort. The list is split
+ * into maximal ascending runs and strictly descending runs, the latter being
+ * reversed in place. Runs are pushed on a fixed-size stack and merged
+ * following the Timsort balancing rules. A merge concatenates the runs if
+ * they do not overlap, and switches to galloping once one run keeps winning.
+ * An already sorted list costs n - 1 comparisons. Like list_sort(), it neither
+ * recurses nor allocates.
+ */
+void list_sort_adaptive(void *priv, struct list_head *head, list_cmp_func_t cmp);
+
+#endif /* LAB0_LIST_SORT_H */
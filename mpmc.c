@@ -0,0 +1,187 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Nodes are allocated and freed concurrently, use regular malloc/free */
+#define INTERNAL 1
+#include "mpmc.h"
+
+struct __mpmc_node {
+    _Atomic(mpmc_node_t *) next;
+    element_t *e;
+};
+
+static mpmc_node_t *node_new(element_t *e)
+{
+    mpmc_node_t *node = malloc(sizeof(mpmc_node_t));
+    if (!node)
+        return NULL;
+    atomic_init(&node->next, NULL);
+    node->e = e;
+    return node;
+}
+
+/* Read the node at src and publish it in hazard pointer hp, until src is seen
+ * unchanged afterwards: it was then still linked when the hazard showed up,
+ * and cannot be freed before the hazard is cleared.
+ */
+static mpmc_node_t *protect(_Atomic(mpmc_node_t *) *hp,
+                            _Atomic(mpmc_node_t *) *src)
+{
+    mpmc_node_t *node = atomic_load(src);
+    for (;;) {
+        atomic_store(hp, node);
+        mpmc_node_t *again = atomic_load(src);
+        if (again == node)
+            return node;
+        node = again;
+    }
+}
+
+static int ptr_cmp(const void *a, const void *b)
+{
+    uintptr_t x = (uintptr_t) * (mpmc_node_t *const *) a;
+    uintptr_t y = (uintptr_t) * (mpmc_node_t *const *) b;
+    return (x > y) - (x < y);
+}
+
+/* Free the nodes retired by t which no hazard pointer of q points to */
+static void scan(mpmc_t *q, mpmc_thread_t *t)
+{
+    mpmc_node_t *hazards[2 * MPMC_MAX_THREADS];
+    int nr_hazards = 0, nr_threads = atomic_load(&q->nr_threads);
+
+    for (int i = 0; i < nr_threads; i++) {
+        for (int j = 0; j < 2; j++) {
+            mpmc_node_t *node = atomic_load(&q->threads[i].hazard[j]);
+            if (node)
+                hazards[nr_hazards++] = node;
+        }
+    }
+    qsort(hazards, nr_hazards, sizeof(mpmc_node_t *), ptr_cmp);
+
+    int kept = 0;
+    for (int i = 0; i < t->nr_retired; i++) {
+        mpmc_node_t *node = t->retired[i];
+        if (bsearch(&node, hazards, nr_hazards, sizeof(mpmc_node_t *),
+                    ptr_cmp))
+            t->retired[kept++] = node;
+        else
+            free(node);
+    }
+    t->nr_retired = kept;
+}
+
+static void retire(mpmc_t *q, mpmc_thread_t *t, mpmc_node_t *node)
+{
+    t->retired[t->nr_retired++] = node;
+    if (t->nr_retired == MPMC_RETIRE_MAX)
+        scan(q, t);
+}
+
+/* Create an empty queue */
+mpmc_t *mpmc_new(void)
+{
+    mpmc_t *q = aligned_alloc(64, sizeof(mpmc_t));
+    if (!q)
+        return NULL;
+
+    mpmc_node_t *dummy = node_new(NULL);
+    if (!dummy) {
+        free(q);
+        return NULL;
+    }
+    memset(q, 0, sizeof(mpmc_t));
+    atomic_init(&q->head, dummy);
+    atomic_init(&q->tail, dummy);
+    atomic_init(&q->nr_threads, 0);
+    return q;
+}
+
+/* Free the queue and its nodes */
+void mpmc_free(mpmc_t *q)
+{
+    if (!q)
+        return;
+
+    mpmc_node_t *node = atomic_load(&q->head);
+    while (node) {
+        mpmc_node_t *next = atomic_load(&node->next);
+        free(node);
+        node = next;
+    }
+    for (int i = 0; i < atomic_load(&q->nr_threads); i++) {
+        for (int j = 0; j < q->threads[i].nr_retired; j++)
+            free(q->threads[i].retired[j]);
+    }
+    free(q);
+}
+
+/* Register the calling thread with q */
+mpmc_thread_t *mpmc_join(mpmc_t *q)
+{
+    int i = atomic_fetch_add(&q->nr_threads, 1);
+    if (i >= MPMC_MAX_THREADS) {
+        atomic_fetch_sub(&q->nr_threads, 1);
+        return NULL;
+    }
+    return &q->threads[i];
+}
+
+/* Insert an element at tail of q */
+bool mpmc_insert_tail(mpmc_t *q, mpmc_thread_t *t, element_t *e)
+{
+    mpmc_node_t *node = node_new(e);
+    if (!node)
+        return false;
+
+    for (;;) {
+        mpmc_node_t *tail = protect(&t->hazard[0], &q->tail);
+        mpmc_node_t *next = atomic_load(&tail->next);
+        if (tail != atomic_load(&q->tail))
+            continue;
+        if (next) {
+            /* Another insert linked its node, help it move the tail */
+            atomic_compare_exchange_weak(&q->tail, &tail, next);
+            continue;
+        }
+        if (atomic_compare_exchange_weak(&tail->next, &next, node)) {
+            atomic_compare_exchange_strong(&q->tail, &tail, node);
+            break;
+        }
+    }
+    atomic_store(&t->hazard[0], NULL);
+    return true;
+}
+
+/* Remove an element from head of q */
+element_t *mpmc_remove_head(mpmc_t *q, mpmc_thread_t *t)
+{
+    element_t *e = NULL;
+
+    for (;;) {
+        mpmc_node_t *head = protect(&t->hazard[0], &q->head);
+        mpmc_node_t *tail = atomic_load(&q->tail);
+        mpmc_node_t *next = protect(&t->hazard[1], &head->next);
+        if (head != atomic_load(&q->head))
+            continue;
+        if (!next)
+            break;
+        if (head == tail) {
+            /* The tail lags behind a node being inserted */
+            atomic_compare_exchange_weak(&q->tail, &tail, next);
+            continue;
+        }
+        /* next turns into the dummy node, and head goes */
+        element_t *first = next->e;
+        if (atomic_compare_exchange_weak(&q->head, &head, next)) {
+            atomic_store(&t->hazard[0], NULL);
+            retire(q, t, head);
+            e = first;
+            break;
+        }
+    }
+    atomic_store(&t->hazard[0], NULL);
+    atomic_store(&t->hazard[1], NULL);
+    return e;
+}
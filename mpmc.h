@@ -0,0 +1,81 @@
+#ifndef LAB0_MPMC_H
+#define LAB0_MPMC_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#include "queue.h"
+
+/* Lock-free FIFO of queue elements, which any number of threads can insert at
+ * the tail of and remove from the head of at the same time.
+ *
+ * It is the queue of Michael and Scott, "Simple, Fast, and Practical
+ * Non-Blocking and Blocking Concurrent Queue Algorithms" (PODC 1996): a
+ * singly-linked list of nodes, starting with a dummy one, whose head and tail
+ * move by compare-and-swap. Nodes removed are reclaimed with hazard pointers
+ * (Michael, IEEE TPDS 2004), so that no thread frees a node another one is
+ * about to read.
+ *
+ * Nodes come from the regular malloc, which unlike test_malloc is thread-safe.
+ * The elements stay owned by the caller.
+ */
+
+/* Most threads which can join a queue over its lifetime */
+#define MPMC_MAX_THREADS 64
+
+/* Nodes a thread retires before it scans the hazard pointers. It is more
+ * than the hazard pointers of all threads, so each scan frees some.
+ */
+#define MPMC_RETIRE_MAX (4 * MPMC_MAX_THREADS)
+
+typedef struct __mpmc_node mpmc_node_t;
+
+/**
+ * mpmc_thread_t - State of one thread using a queue
+ * @hazard: nodes the thread is reading, which must not be freed
+ * @retired: nodes the thread removed, to free once no hazard points to them
+ * @nr_retired: number of nodes in @retired
+ */
+typedef struct {
+    _Alignas(64) _Atomic(mpmc_node_t *) hazard[2];
+    mpmc_node_t *retired[MPMC_RETIRE_MAX];
+    int nr_retired;
+} mpmc_thread_t;
+
+/**
+ * mpmc_t - Lock-free queue
+ * @head: dummy node, followed by the first element
+ * @tail: last node, or one lagging behind it for a while
+ * @nr_threads: number of entries of @threads handed out by mpmc_join()
+ * @threads: state of the threads using the queue
+ *
+ * @head and @tail sit on cache lines of their own, producers and consumers
+ * writing one each.
+ */
+typedef struct {
+    _Alignas(64) _Atomic(mpmc_node_t *) head;
+    _Alignas(64) _Atomic(mpmc_node_t *) tail;
+    _Alignas(64) atomic_int nr_threads;
+    mpmc_thread_t threads[MPMC_MAX_THREADS];
+} mpmc_t;
+
+/* Create an empty queue. Return NULL if allocation fails */
+mpmc_t *mpmc_new(void);
+
+/* Free the queue, which no thread may use any longer. Elements left in it are
+ * not released.
+ */
+void mpmc_free(mpmc_t *q);
+
+/* Register the calling thread with q, and return the state it passes to the
+ * other functions, or NULL if MPMC_MAX_THREADS threads already joined.
+ */
+mpmc_thread_t *mpmc_join(mpmc_t *q);
+
+/* Insert element e at the tail of q. Return false if allocation fails */
+bool mpmc_insert_tail(mpmc_t *q, mpmc_thread_t *t, element_t *e);
+
+/* Remove the element at the head of q. Return NULL if q is empty */
+element_t *mpmc_remove_head(mpmc_t *q, mpmc_thread_t *t);
+
+#endif /* LAB0_MPMC_H */
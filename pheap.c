@@ -0,0 +1,82 @@
+#include "pheap.h"
+#include "queue_sort.h"
+
+/* Link of node to its first child, kept in list.next */
+static inline struct list_head **child(struct list_head *node)
+{
+    return &node->next;
+}
+
+/* Link of node to its next sibling, kept in list.prev */
+static inline struct list_head **sibling(struct list_head *node)
+{
+    return &node->prev;
+}
+
+/* Meld two heaps: the root with the greater string becomes the first child of
+ * the other one
+ */
+static struct list_head *meld(size_t *compares,
+                              struct list_head *a,
+                              struct list_head *b)
+{
+    if (element_cmp(compares, a, b) > 0) {
+        struct list_head *tmp = a;
+        a = b;
+        b = tmp;
+    }
+    *sibling(b) = *child(a);
+    *child(a) = b;
+    return a;
+}
+
+void pheap_insert(pheap_t *h, element_t *e)
+{
+    struct list_head *node = &e->list;
+    *child(node) = *sibling(node) = NULL;
+    h->root = h->root ? meld(&h->compares, h->root, node) : node;
+    h->size++;
+}
+
+/* Meld a list of sibling heaps into one, in two passes */
+static struct list_head *merge_pairs(size_t *compares, struct list_head *first)
+{
+    struct list_head *pairs = NULL; /* melded pairs, last one first */
+
+    /* Meld the heaps two by two from left to right */
+    while (first) {
+        struct list_head *a = first, *b = *sibling(a);
+        if (!b) {
+            *sibling(a) = pairs;
+            pairs = a;
+            break;
+        }
+        first = *sibling(b);
+        *sibling(a) = *sibling(b) = NULL;
+        a = meld(compares, a, b);
+        *sibling(a) = pairs;
+        pairs = a;
+    }
+
+    /* Then meld the pairs into one from right to left */
+    struct list_head *root = NULL;
+    while (pairs) {
+        struct list_head *next = *sibling(pairs);
+        *sibling(pairs) = NULL;
+        root = root ? meld(compares, root, pairs) : pairs;
+        pairs = next;
+    }
+    return root;
+}
+
+element_t *pheap_remove_min(pheap_t *h)
+{
+    struct list_head *root = h->root;
+    if (!root)
+        return NULL;
+
+    h->root = merge_pairs(&h->compares, *child(root));
+    h->size--;
+    INIT_LIST_HEAD(root);
+    return list_entry(root, element_t, list);
+}
@@ -0,0 +1,46 @@
+#ifndef LAB0_PHEAP_H
+#define LAB0_PHEAP_H
+
+#include <stddef.h>
+
+#include "queue.h"
+
+/* Priority queue of queue elements, which hands out the smallest string
+ * first, as a pairing heap (Fredman, Sedgewick, Sleator and Tarjan, "The
+ * pairing heap: A new form of self-adjusting heap", Algorithmica 1986).
+ *
+ * Each element links into the heap through its list member: list.next points
+ * to its first child and list.prev to its next sibling, NULL if none. Inserts
+ * take one comparison with the root. Removing the root melds its children in
+ * pairs from left to right, then the pairs from right to left, in O(log n)
+ * amortized time. Nothing is allocated, the elements stay owned by the caller.
+ */
+
+/**
+ * pheap_t - Pairing heap of elements
+ * @root: list member of the smallest element, or NULL if the heap is empty
+ * @size: number of elements in the heap
+ * @compares: number of comparisons made so far
+ */
+typedef struct {
+    struct list_head *root;
+    int size;
+    size_t compares;
+} pheap_t;
+
+static inline void pheap_init(pheap_t *h)
+{
+    h->root = NULL;
+    h->size = 0;
+    h->compares = 0;
+}
+
+/* Insert element e into h */
+void pheap_insert(pheap_t *h, element_t *e);
+
+/* Remove the element with the smallest string from h. Return NULL if h is
+ * empty.
+ */
+element_t *pheap_remove_min(pheap_t *h);
+
+#endif /* LAB0_PHEAP_H */
@@ -0,0 +1,112 @@
+/* Slab allocator layered on top of test_malloc */
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "harness.h"
+#include "pool.h"
+
+/* Size of each slab requested from test_malloc, including its header */
+#define POOL_SLAB_SIZE (32 * 1024)
+
+#define POOL_NR_CLASSES (POOL_MAX_SIZE / POOL_ALIGN)
+
+/* Header at the beginning of every slab, padded to keep blocks aligned */
+typedef struct __pool_slab {
+    struct __pool_slab *next;
+    char pad[POOL_ALIGN - sizeof(struct __pool_slab *)];
+} pool_slab_t;
+
+/* A released block, linked through its first bytes */
+typedef struct __pool_block {
+    struct __pool_block *next;
+} pool_block_t;
+
+typedef struct {
+    pool_block_t *free_list; /* released blocks, ready for reuse */
+    char *cur, *end;         /* unused tail of the newest slab */
+} pool_class_t;
+
+static pool_class_t classes[POOL_NR_CLASSES];
+static pool_slab_t *slabs = NULL;
+static size_t nr_used = 0;
+
+static inline pool_class_t *size_class(size_t size)
+{
+    return &classes[(size - 1) / POOL_ALIGN];
+}
+
+/* Get a fresh slab for class c. Return false if test_malloc fails */
+static bool pool_grow(pool_class_t *c)
+{
+    pool_slab_t *slab = test_malloc(POOL_SLAB_SIZE);
+    if (!slab)
+        return false;
+
+    slab->next = slabs;
+    slabs = slab;
+    c->cur = (char *) (slab + 1);
+    c->end = (char *) slab + POOL_SLAB_SIZE;
+    return true;
+}
+
+void *pool_alloc(size_t size)
+{
+    if (!size || size > POOL_MAX_SIZE)
+        return test_malloc(size);
+
+    pool_class_t *c = size_class(size);
+    size_t block_size = (size + POOL_ALIGN - 1) & ~(size_t) (POOL_ALIGN - 1);
+    bool grow = !c->free_list && (size_t) (c->end - c->cur) < block_size;
+
+    /* Apply noallocate mode and failure injection to every block. A block
+     * from a new slab went through them in test_malloc already.
+     */
+    if (grow ? !pool_grow(c) : !test_malloc_permitted())
+        return NULL;
+
+    void *p;
+    if (c->free_list) {
+        p = c->free_list;
+        c->free_list = c->free_list->next;
+    } else {
+        p = c->cur;
+        c->cur += block_size;
+    }
+
+    nr_used++;
+    return p;
+}
+
+void pool_free(void *p, size_t size)
+{
+    if (!size || size > POOL_MAX_SIZE) {
+        test_free(p);
+        return;
+    }
+
+    if (!p || !test_free_permitted())
+        return;
+
+    pool_block_t *b = p;
+    pool_class_t *c = size_class(size);
+    b->next = c->free_list;
+    c->free_list = b;
+    nr_used--;
+}
+
+void pool_release()
+{
+    if (nr_used)
+        return;
+
+    while (slabs) {
+        pool_slab_t *next = slabs->next;
+        test_free(slabs);
+        slabs = next;
+    }
+    for (int i = 0; i < POOL_NR_CLASSES; i++) {
+        classes[i].free_list = NULL;
+        classes[i].cur = classes[i].end = NULL;
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef LAB0_POOL_H
+#define LAB0_POOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Slab allocator for the small blocks used by queue elements.
+ *
+ * Blocks up to POOL_MAX_SIZE bytes are carved out of slabs obtained from
+ * test_malloc, one size class per POOL_ALIGN bytes. Released blocks go to an
+ * intrusive free list of their size class, so both pool_alloc and pool_free
+ * are O(1). Larger blocks are passed straight to test_malloc and test_free.
+ */
+
+#define POOL_ALIGN 16
+#define POOL_MAX_SIZE 128
+
+/* Allocate a block of size bytes. Return NULL if allocation fails */
+void *pool_alloc(size_t size);
+
+/* Release a block obtained from pool_alloc with the same size */
+void pool_free(void *p, size_t size);
+
+/* Return every slab to test_free if no block is in use */
+void pool_release();
+
+/* Whether a block allocated with size bytes can be used for, and then released
+ * with, fit bytes instead
+ */
+static inline bool pool_fits(size_t size, size_t fit)
+{
+    if (size > POOL_MAX_SIZE)
+        return fit > POOL_MAX_SIZE && fit <= size;
+    return fit && (fit + POOL_ALIGN - 1) / POOL_ALIGN ==
+                      (size + POOL_ALIGN - 1) / POOL_ALIGN;
+}
+
+#endif /* LAB0_POOL_H */
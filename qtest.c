@@ -3,6 +3,9 @@
 #include <assert.h>
 #include <errno.h>
 #include <getopt.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
 #include <signal.h>
 #include <spawn.h>
 #include <stdio.h>
@@ -45,7 +48,12 @@ extern int show_entropy;
 #include "queue.h"
 
 #include "console.h"
+#include "mpmc.h"
+#include "pheap.h"
+#include "queue_sort.h"
 #include "report.h"
+#include "shard.h"
+#include "spsc.h"
 
 /* Settable parameters */
 
@@ -77,6 +85,18 @@ static int string_length = MAXSTRING;
 #define MAX_RANDSTR_LEN 10
 static const char charset[] = "abcdefghijklmnopqrstuvwxyz";
 
+/* Random strings may start with a prefix they all share, made of rand_prefix
+ * copies of charset[0], to test sorting strings which differ only late.
+ */
+#define MAX_RANDSTR_PREFIX (MAXSTRING - MAX_RANDSTR_LEN)
+static int rand_prefix = 0;
+
+/* Percent of random strings which repeat one of the last RANDSTR_HISTORY ones
+ * generated, set by option randdup
+ */
+#define RANDSTR_HISTORY 1024
+static int rand_dup = 0;
+
 /* Forward declarations */
 static bool q_show(int vlevel);
 
@@ -160,10 +180,27 @@ static bool do_new(int argc, char *argv[])
 
 /* TODO: Add a buf_size check of if the buf_size may be less
  * than MIN_RANDSTR_LEN.
+ * buf_size is the room for the random part only, buf must have another
+ * MAX_RANDSTR_PREFIX bytes in front of it for the shared prefix.
  */
 static void fill_rand_string(char *buf, size_t buf_size)
 {
-    size_t len = 0;
+    size_t len = 0, prefix = 0;
+    if (rand_prefix > 0)
+        prefix = rand_prefix < MAX_RANDSTR_PREFIX ? rand_prefix
+                                                  : MAX_RANDSTR_PREFIX;
+    memset(buf, charset[0], prefix);
+    buf += prefix;
+
+    static char history[RANDSTR_HISTORY][MAX_RANDSTR_LEN];
+    static size_t nr_history = 0;
+    if (nr_history && rand() % 100 < rand_dup) {
+        size_t n = nr_history < RANDSTR_HISTORY ? nr_history : RANDSTR_HISTORY;
+        strncpy(buf, history[rand() % n], buf_size);
+        buf[buf_size - 1] = '\0';
+        return;
+    }
+
     while (len < MIN_RANDSTR_LEN)
         len = rand() % buf_size;
 
@@ -171,6 +208,76 @@ static void fill_rand_string(char *buf, size_t buf_size)
     for (size_t n = 0; n < len; n++)
         buf[n] = charset[buf[n] % (sizeof(charset) - 1)];
     buf[len] = '\0';
+    if (len < MAX_RANDSTR_LEN)
+        memcpy(history[nr_history++ % RANDSTR_HISTORY], buf, len + 1);
+}
+
+/* ih and it with a count insert up to BULK_BATCH strings per call of the bulk
+ * API, and rhn and rtn remove all elements in one call, unless use_bulk is
+ * cleared to compare with one call per element.
+ */
+#define BULK_BATCH 1024
+static int use_bulk = 1;
+
+/* Insert reps copies of inserts, or random strings if need_rand, at head
+ * (at_head) or tail of the current queue with the bulk API. Return false on
+ * error.
+ */
+static bool insert_bulk(char *inserts, bool need_rand, int reps, bool at_head)
+{
+    /* Static, as the time limit may longjmp out of here */
+    static char *strs[BULK_BATCH];
+    static char randstrs[BULK_BATCH][MAX_RANDSTR_PREFIX + MAX_RANDSTR_LEN];
+    bool ok = true;
+
+    for (int r = 0; ok && r < reps; r += BULK_BATCH) {
+        int n = reps - r < BULK_BATCH ? reps - r : BULK_BATCH;
+        for (int i = 0; i < n; i++) {
+            strs[i] = inserts;
+            if (need_rand) {
+                strs[i] = randstrs[i];
+                fill_rand_string(randstrs[i], MAX_RANDSTR_LEN);
+            }
+        }
+
+        int done = at_head ? q_insert_head_bulk(current->q, strs, n)
+                           : q_insert_tail_bulk(current->q, strs, n);
+        current->size += done;
+        if (done) {
+            /* The last string inserted is at the end it went to */
+            q_iter_t it;
+            element_t *e =
+                at_head ? q_first(current->q, &it) : q_last(current->q);
+            if (!e->value) {
+                report(1, "ERROR: Failed to save copy of string in queue");
+                ok = false;
+            } else if (e->value == strs[n - 1]) {
+                report(1,
+                       "ERROR: Need to allocate and copy string for new queue "
+                       "element");
+                ok = false;
+            } else if (at_head && done > 1 && e->value == q_next(&it)->value) {
+                report(1,
+                       "ERROR: Need to allocate separate string for each queue "
+                       "element");
+                ok = false;
+            }
+        }
+        if (done < n) {
+            fail_count += n - done;
+            if (fail_count < fail_limit) {
+                report(2, "Insertion of %d strings failed", n - done);
+            } else {
+                report(1,
+                       "ERROR: Insertion of %d strings failed (%d failures "
+                       "total)",
+                       n - done, fail_count);
+                ok = false;
+            }
+        }
+        ok = ok && !error_check();
+    }
+    return ok;
 }
 
 /* insert head */
@@ -192,7 +299,7 @@ static bool do_ih(int argc, char *argv[])
     }
 
     char *lasts = NULL;
-    char randstr_buf[MAX_RANDSTR_LEN];
+    char randstr_buf[MAX_RANDSTR_PREFIX + MAX_RANDSTR_LEN];
     int reps = 1;
     bool ok = true, need_rand = false;
     if (argc != 2 && argc != 3) {
@@ -217,15 +324,18 @@ static bool do_ih(int argc, char *argv[])
         report(3, "Warning: Calling insert head on null queue");
     error_check();
 
-    if (current && exception_setup(true)) {
+    bool bulk = reps > 1 && use_bulk;
+    if (current && bulk && exception_setup(true)) {
+        ok = insert_bulk(inserts, need_rand, reps, true);
+    } else if (current && !bulk && exception_setup(true)) {
         for (int r = 0; ok && r < reps; r++) {
             if (need_rand)
-                fill_rand_string(randstr_buf, sizeof(randstr_buf));
+                fill_rand_string(randstr_buf, MAX_RANDSTR_LEN);
             bool rval = q_insert_head(current->q, inserts);
             if (rval) {
                 current->size++;
-                char *cur_inserts =
-                    list_entry(current->q->next, element_t, list)->value;
+                q_iter_t it;
+                char *cur_inserts = q_first(current->q, &it)->value;
                 if (!cur_inserts) {
                     report(1, "ERROR: Failed to save copy of string in queue");
                     ok = false;
@@ -281,7 +391,7 @@ static bool do_it(int argc, char *argv[])
         return ok;
     }
 
-    char randstr_buf[MAX_RANDSTR_LEN];
+    char randstr_buf[MAX_RANDSTR_PREFIX + MAX_RANDSTR_LEN];
     int reps = 1;
     bool ok = true, need_rand = false;
     if (argc != 2 && argc != 3) {
@@ -306,15 +416,17 @@ static bool do_it(int argc, char *argv[])
         report(3, "Warning: Calling insert tail on null queue");
     error_check();
 
-    if (current && exception_setup(true)) {
+    bool bulk = reps > 1 && use_bulk;
+    if (current && bulk && exception_setup(true)) {
+        ok = insert_bulk(inserts, need_rand, reps, false);
+    } else if (current && !bulk && exception_setup(true)) {
         for (int r = 0; ok && r < reps; r++) {
             if (need_rand)
-                fill_rand_string(randstr_buf, sizeof(randstr_buf));
+                fill_rand_string(randstr_buf, MAX_RANDSTR_LEN);
             bool rval = q_insert_tail(current->q, inserts);
             if (rval) {
                 current->size++;
-                char *cur_inserts =
-                    list_entry(current->q->prev, element_t, list)->value;
+                char *cur_inserts = q_last(current->q)->value;
                 if (!cur_inserts) {
                     report(1, "ERROR: Failed to save copy of string in queue");
                     ok = false;
@@ -338,6 +450,138 @@ static bool do_it(int argc, char *argv[])
     return ok;
 }
 
+/* Most bytes of removed strings rhn and rtn check */
+#define REMOVE_N_BUFSIZE (1 << 20)
+
+/* Check that the strings packed in buf, of bufsize bytes, are those of the
+ * elements of list
+ */
+static bool check_packed(struct list_head *list, char *buf, size_t bufsize)
+{
+    element_t *e;
+    list_for_each_entry (e, list, list) {
+        if (!bufsize)
+            break;
+        size_t len = strlen(e->value) + 1;
+        if (len > bufsize ? strncmp(buf, e->value, bufsize - 1) ||
+                                buf[bufsize - 1] != '\0'
+                          : strcmp(buf, e->value)) {
+            report(1, "ERROR: Removed value %s not copied to buffer",
+                   e->value);
+            return false;
+        }
+        len = len < bufsize ? len : bufsize;
+        buf += len;
+        bufsize -= len;
+    }
+    return true;
+}
+
+/* Remove n elements from head (option 0) or tail of queue at once */
+static bool do_remove_n(int option, int argc, char *argv[])
+{
+    if (argc != 2) {
+        report(1, "%s takes 1 argument", argv[0]);
+        return false;
+    }
+
+    int n;
+    if (!get_int(argv[1], &n) || n <= 0) {
+        report(1, "Invalid number of removals '%s'", argv[1]);
+        return false;
+    }
+
+    size_t bufsize = (size_t) n * (string_length + 1);
+    if (bufsize > REMOVE_N_BUFSIZE)
+        bufsize = REMOVE_N_BUFSIZE;
+    char *removes = malloc(bufsize + STRINGPAD);
+    if (!removes) {
+        report(1,
+               "INTERNAL ERROR.  Could not allocate space for removed strings");
+        return false;
+    }
+    memset(removes, 'X', bufsize + STRINGPAD);
+
+    if (!current || !current->size)
+        report(3, "Warning: Calling remove head on empty queue");
+    error_check();
+
+    int expect = current ? (n < current->size ? n : current->size) : 0;
+    int done = 0;
+    LIST_HEAD(list);
+    if (current && exception_setup(true)) {
+        if (use_bulk) {
+            done = option ? q_remove_tail_n(current->q, n, &list, removes,
+                                            bufsize)
+                          : q_remove_head_n(current->q, n, &list, removes,
+                                            bufsize);
+        } else {
+            /* One element at a time, copying it like rh does */
+            while (done < n) {
+                element_t *e = option ? q_remove_tail(current->q, removes,
+                                                      string_length + 1)
+                                      : q_remove_head(current->q, removes,
+                                                      string_length + 1);
+                if (!e)
+                    break;
+                if (option)
+                    list_add(&e->list, &list);
+                else
+                    list_add_tail(&e->list, &list);
+                done++;
+            }
+        }
+    }
+    exception_cancel();
+
+    bool ok = true;
+    if (done != expect) {
+        report(1, "ERROR: Removed %d elements from queue, expected %d", done,
+               expect);
+        ok = false;
+    } else if (!done) {
+        fail_count++;
+        if (fail_count < fail_limit) {
+            report(2, "Removal from queue failed");
+        } else {
+            report(1, "ERROR: Removal from queue failed (%d failures total)",
+                   fail_count);
+            ok = false;
+        }
+    } else {
+        report(2, "Removed %d elements from queue", done);
+    }
+
+    if (use_bulk) {
+        ok = ok && check_packed(&list, removes, bufsize);
+        size_t i = bufsize;
+        while (i < bufsize + STRINGPAD && removes[i] == 'X')
+            i++;
+        if (i != bufsize + STRINGPAD) {
+            report(1,
+                   "ERROR: copying of strings in remove overflowed "
+                   "destination buffer.");
+            ok = false;
+        }
+    }
+
+    /* Like do_free, skip the check of each block against every block
+     * allocated, which would make releasing them O(done * size)
+     */
+    if (done > BIG_LIST_SIZE)
+        set_cautious_mode(false);
+    element_t *e, *safe;
+    list_for_each_entry_safe (e, safe, &list, list)
+        q_recycle_element(current->q, e);
+    set_cautious_mode(true);
+    if (current)
+        current->size -= done;
+
+    q_show(3);
+    free(removes);
+    return ok && !error_check();
+}
+
 static bool do_remove(int option, int argc, char *argv[])
 {
     // option 0 is for remove head; option 1 is for remove tail
@@ -409,7 +653,7 @@ static bool do_remove(int option, int argc, char *argv[])
     if (!is_null) {
         // q_remove_head and q_remove_tail are not responsible for releasing
         // node
-        q_release_element(re);
+        q_recycle_element(current->q, re);
 
         removes[string_length + STRINGPAD] = '\0';
         if (removes[0] == '\0') {
@@ -466,6 +710,125 @@ static inline bool do_rt(int argc, char *argv[])
     return do_remove(1, argc, argv);
 }
 
+static inline bool do_rhn(int argc, char *argv[])
+{
+    return do_remove_n(0, argc, argv);
+}
+
+static inline bool do_rtn(int argc, char *argv[])
+{
+    return do_remove_n(1, argc, argv);
+}
+
+static bool do_churn(int argc, char *argv[])
+{
+    if (argc != 3) {
+        report(1, "%s takes 2 arguments", argv[0]);
+        return false;
+    }
+
+    int reps;
+    if (!get_int(argv[2], &reps) || reps < 0) {
+        report(1, "Invalid number of churns '%s'", argv[2]);
+        return false;
+    }
+
+    if (!current) {
+        report(3, "Warning: Calling churn on null queue");
+        return false;
+    }
+    error_check();
+
+    char value[MAXSTRING + 1];
+    bool ok = true;
+    /* Like do_free, skip the check of each block against every block
+     * allocated, which would make each release O(size)
+     */
+    set_cautious_mode(false);
+    if (exception_setup(false)) {
+        for (int r = 0; ok && r < reps; r++) {
+            ok = q_insert_tail(current->q, argv[1]);
+            element_t *e =
+                ok ? q_remove_head(current->q, value, sizeof(value)) : NULL;
+            ok = ok && e;
+            q_recycle_element(current->q, e);
+        }
+    }
+    exception_cancel();
+    set_cautious_mode(true);
+
+    if (!ok)
+        report(1, "ERROR: Failed to insert or remove an element");
+    q_show(3);
+    return ok && !error_check();
+}
+
+static bool do_mem(int argc, char *argv[])
+{
+    if (argc != 1) {
+        report(1, "%s takes no arguments", argv[0]);
+        return false;
+    }
+
+    size_t bytes, peak, blocks;
+    allocation_stats(&bytes, &peak, &blocks);
+    report(1, "%zu bytes allocated, peak %zu, %zu blocks handed out", bytes,
+           peak, blocks);
+    return true;
+}
+
+static long elapsed_ns(const struct timespec *from, const struct timespec *to)
+{
+    return (to->tv_sec - from->tv_sec) * 1000000000L + to->tv_nsec -
+           from->tv_nsec;
+}
+
+typedef struct {
+    const char *value;
+    int index;
+} dedup_entry_t;
+
+static int string_cmp(const void *a, const void *b)
+{
+    return strcmp(*(char *const *) a, *(char *const *) b);
+}
+
+static int dedup_entry_cmp(const void *a, const void *b)
+{
+    return strcmp(((const dedup_entry_t *) a)->value,
+                  ((const dedup_entry_t *) b)->value);
+}
+
+/* Flag each of the n elements of list l whose string is found more than once
+ * anywhere in it, which sorting brings together. Return NULL if allocation
+ * fails.
+ */
+static bool *find_dups(struct list_head *l, int n)
+{
+    dedup_entry_t *entries = malloc(sizeof(dedup_entry_t) * (n + 1));
+    bool *dups = calloc(n + 1, sizeof(bool));
+    if (!entries || !dups) {
+        free(entries);
+        free(dups);
+        return NULL;
+    }
+
+    element_t *item;
+    int i = 0;
+    list_for_each_entry (item, l, list) {
+        entries[i].value = item->value;
+        entries[i].index = i;
+        i++;
+    }
+    qsort(entries, n, sizeof(dedup_entry_t), dedup_entry_cmp);
+    for (i = 1; i < n; i++) {
+        if (!strcmp(entries[i - 1].value, entries[i].value))
+            dups[entries[i - 1].index] = dups[entries[i].index] = true;
+    }
+    free(entries);
+    return dups;
+}
+
 static bool do_dedup(int argc, char *argv[])
 {
     if (argc != 1) {
@@ -475,10 +838,11 @@ static bool do_dedup(int argc, char *argv[])
 
     LIST_HEAD(l_copy);
     element_t *item = NULL, *tmp = NULL;
+    q_iter_t it;
 
     // Copy current->q to l_copy
-    if (current->q && !list_empty(current->q)) {
-        list_for_each_entry (item, current->q, list) {
+    if (current->q) {
+        for (item = q_first(current->q, &it); item; item = q_next(&it)) {
             size_t slen;
             tmp = malloc(sizeof(element_t));
             if (!tmp)
@@ -494,7 +858,23 @@ static bool do_dedup(int argc, char *argv[])
             list_add_tail(&tmp->list, &l_copy);
         }
         // Return false if the loop does not leave properly
-        if (&item->list != current->q) {
+        if (item) {
+            list_for_each_entry_safe (item, tmp, &l_copy, list) {
+                free(item->value);
+                free(item);
+            }
+            report(1,
+                   "INTERNAL ERROR.  Could not allocate space for "
+                   "duplicate checking");
+            return false;
+        }
+    }
+
+    /* Duplicates anywhere in the queue go with dedup_hash */
+    bool *dups = NULL;
+    if (dedup_hash) {
+        dups = find_dups(&l_copy, current->size);
+        if (!dups) {
             list_for_each_entry_safe (item, tmp, &l_copy, list) {
                 free(item->value);
                 free(item);
@@ -506,22 +886,47 @@ static bool do_dedup(int argc, char *argv[])
         }
     }
 
+    /* Like do_free, skip the check of each block released against every block
+     * allocated, which would make deleting them O(dups * size)
+     */
+    if (current->size > BIG_LIST_SIZE)
+        set_cautious_mode(false);
     bool ok = true;
+    struct timespec from, to;
+    clock_gettime(CLOCK_MONOTONIC, &from);
     if (exception_setup(true))
         ok = q_delete_dup(current->q);
     exception_cancel();
+    clock_gettime(CLOCK_MONOTONIC, &to);
+    set_cautious_mode(true);
+    report(2, "Duplicates deleted in %ld us", elapsed_ns(&from, &to) / 1000);
 
     if (!ok) {
         list_for_each_entry_safe (item, tmp, &l_copy, list) {
             free(item->value);
             free(item);
         }
-        report(1, "ERROR: Calling delete duplicate on null queue");
+        free(dups);
+        if (!current->q) {
+            report(1, "ERROR: Calling delete duplicate on null queue");
+            return false;
+        }
+        /* Only the hash table of dedup_hash is allocated, and it failed */
+        fail_count++;
+        if (fail_count < fail_limit) {
+            report(2, "Allocation of duplicate table failed");
+            return !error_check();
+        }
+        report(1,
+               "ERROR: Allocation of duplicate table failed (%d failures "
+               "total)",
+               fail_count);
         return false;
     }
 
-    struct list_head *l_tmp = current->q->next;
+    element_t *kept = q_first(current->q, &it);
     bool is_this_dup = false;
+    int i = 0;
     // Compare between new list and old one
     list_for_each_entry (item, &l_copy, list) {
         // Skip comparison with new list if the string is duplicate
@@ -529,19 +934,17 @@ static bool do_dedup(int argc, char *argv[])
             item->list.next != &l_copy &&
             strcmp(list_entry(item->list.next, element_t, list)->value,
                    item->value) == 0;
-        if (is_this_dup || is_next_dup) {
+        if (dups ? dups[i++] : is_this_dup || is_next_dup) {
             // Update list size
             current->size--;
-        } else if (l_tmp != current->q &&
-                   strcmp(list_entry(l_tmp, element_t, list)->value,
-                          item->value) == 0)
-            l_tmp = l_tmp->next;
+        } else if (kept && strcmp(kept->value, item->value) == 0)
+            kept = q_next(&it);
         else
             ok = false;
         is_this_dup = is_next_dup;
     }
     // All elements in new list should be traversed
-    ok = ok && l_tmp == current->q;
+    ok = ok && !kept;
     if (!ok)
         report(1,
                "ERROR: Duplicate strings are in queue or distinct strings are "
@@ -551,6 +954,7 @@ static bool do_dedup(int argc, char *argv[])
         free(item->value);
         free(item);
     }
+    free(dups);
 
     q_show(3);
     return ok && !error_check();
@@ -644,20 +1048,26 @@ bool do_sort(int argc, char *argv[])
     error_check();
 
     set_noallocate_mode(true);
+    struct timespec from, to;
+    clock_gettime(CLOCK_MONOTONIC, &from);
     if (current && exception_setup(true))
         q_sort(current->q);
     exception_cancel();
+    clock_gettime(CLOCK_MONOTONIC, &to);
     set_noallocate_mode(false);
+    report(2, "Sorted in %ld us", elapsed_ns(&from, &to) / 1000);
+
+    if (cnt > 0)
+        report(2, "Comparisons per element = %.2f",
+               (double) sort_compares / cnt);
 
     bool ok = true;
     if (current && current->size) {
-        for (struct list_head *cur_l = current->q->next;
-             cur_l != current->q && --cnt; cur_l = cur_l->next) {
+        q_iter_t it;
+        element_t *item = q_first(current->q, &it), *next_item;
+        for (; item && --cnt && (next_item = q_next(&it)); item = next_item) {
             /* Ensure each element in ascending order */
             /* FIXME: add an option to specify sorting order */
-            element_t *item, *next_item;
-            item = list_entry(cur_l, element_t, list);
-            next_item = list_entry(cur_l->next, element_t, list);
             if (strcmp(item->value, next_item->value) > 0) {
                 report(1, "ERROR: Not sorted in ascending order");
                 ok = false;
@@ -670,100 +1080,465 @@ bool do_sort(int argc, char *argv[])
     return ok && !error_check();
 }
 
-static bool do_dm(int argc, char *argv[])
+static bool do_sortunique(int argc, char *argv[])
 {
     if (argc != 1) {
         report(1, "%s takes no arguments", argv[0]);
         return false;
     }
 
-    if (!current || !current->q)
-        report(3, "Warning: Try to access null queue");
+    if (!current || !current->q) {
+        report(3, "Warning: Calling sortunique on null queue");
+        return false;
+    }
     error_check();
 
-    bool ok = true;
-    if (exception_setup(true))
-        ok = q_delete_mid(current->q);
-    exception_cancel();
-
-    current->size--;
-    q_show(3);
-    return ok && !error_check();
-}
-
-static bool do_swap(int argc, char *argv[])
-{
-    if (argc != 1) {
-        report(1, "%s takes no arguments", argv[0]);
+    /* Copy the strings, sorted, to find the ones which should be left */
+    int n = current->size;
+    dedup_entry_t *entries = malloc(sizeof(dedup_entry_t) * (n + 1));
+    if (!entries) {
+        report(1, "INTERNAL ERROR.  Could not allocate space for checking");
         return false;
     }
+    q_iter_t it;
+    int i = 0;
+    for (element_t *e = q_first(current->q, &it); e && i < n;
+         e = q_next(&it)) {
+        entries[i].value = strdup(e->value);
+        entries[i].index = i;
+        if (!entries[i].value)
+            break;
+        i++;
+    }
+    if (i < n) {
+        while (i--)
+            free((char *) entries[i].value);
+        free(entries);
+        report(1, "INTERNAL ERROR.  Could not allocate space for checking");
+        return false;
+    }
+    qsort(entries, n, sizeof(dedup_entry_t), dedup_entry_cmp);
 
-    if (!current || !current->q)
-        report(3, "Warning: Try to access null queue");
-    error_check();
-
-    set_noallocate_mode(true);
+    /* Like do_dedup, skip the check of each block released against every
+     * block allocated
+     */
+    if (current->size > BIG_LIST_SIZE)
+        set_cautious_mode(false);
+    int cnt = current->size;
+    struct timespec from, to;
+    clock_gettime(CLOCK_MONOTONIC, &from);
     if (exception_setup(true))
-        q_swap(current->q);
+        cnt = q_sort_unique(current->q);
     exception_cancel();
+    clock_gettime(CLOCK_MONOTONIC, &to);
+    set_cautious_mode(true);
+    report(2, "Sorted and deduplicated in %ld us",
+           elapsed_ns(&from, &to) / 1000);
 
-    set_noallocate_mode(false);
+    if (n > 0)
+        report(2, "Comparisons per element = %.2f",
+               (double) sort_compares / n);
+
+    bool ok = true;
+    element_t *kept = q_first(current->q, &it);
+    int left = 0;
+    for (i = 0; i < n; i++) {
+        const char *value = entries[i].value;
+        if ((i > 0 && !strcmp(entries[i - 1].value, value)) ||
+            (i + 1 < n && !strcmp(value, entries[i + 1].value)))
+            continue;
+        if (!kept || strcmp(kept->value, value)) {
+            ok = false;
+            break;
+        }
+        kept = q_next(&it);
+        left++;
+    }
+    ok = ok && !kept;
+    if (!ok)
+        report(1,
+               "ERROR: Queue is not sorted, holds duplicate strings or lost "
+               "distinct ones");
+    else if (cnt != left) {
+        report(1, "ERROR: Returned %d elements left, but %d are", cnt, left);
+        ok = false;
+    }
+    current->size = left;
+
+    for (i = 0; i < n; i++)
+        free((char *) entries[i].value);
+    free(entries);
 
     q_show(3);
-    return !error_check();
+    return ok && !error_check();
 }
 
-static bool do_descend(int argc, char *argv[])
+static bool do_select(int argc, char *argv[])
 {
-    if (argc != 1) {
-        report(1, "%s takes too much arguments", argv[0]);
+    if (argc != 2) {
+        report(1, "%s takes 1 argument", argv[0]);
         return false;
     }
 
-    if (!current || !current->q)
-        report(3, "Warning: Calling ascend on null queue");
-    error_check();
-
+    int k;
+    if (!get_int(argv[1], &k)) {
+        report(1, "Invalid index '%s'", argv[1]);
+        return false;
+    }
 
-    int cnt = q_size(current->q);
-    if (cnt < 2)
-        report(3, "Warning: Calling ascend on single node");
+    if (!current || !current->q) {
+        report(3, "Warning: Calling select on null queue");
+        return false;
+    }
     error_check();
 
+    /* Copy the strings, sorted, to know the one to find */
+    int n = current->size;
+    char **values = malloc(sizeof(char *) * (n + 1));
+    if (!values) {
+        report(1, "INTERNAL ERROR.  Could not allocate space for checking");
+        return false;
+    }
+    q_iter_t it;
+    int i = 0;
+    for (element_t *e = q_first(current->q, &it); e && i < n;
+         e = q_next(&it), i++)
+        values[i] = e->value;
+    qsort(values, i, sizeof(char *), string_cmp);
+
+    element_t *found = NULL;
+    struct timespec from, to;
+    clock_gettime(CLOCK_MONOTONIC, &from);
+    set_noallocate_mode(true);
     if (exception_setup(true))
-        current->size = q_descend(current->q);
+        found = q_select(current->q, k);
+    exception_cancel();
     set_noallocate_mode(false);
+    clock_gettime(CLOCK_MONOTONIC, &to);
+    report(2, "Selected in %ld us", elapsed_ns(&from, &to) / 1000);
+    if (n > 0)
+        report(2, "Comparisons per element = %.2f",
+               (double) sort_compares / n);
 
     bool ok = true;
-
-    cnt = current->size;
-    if (current->size) {
-        for (struct list_head *cur_l = current->q->next;
-             cur_l != current->q && --cnt; cur_l = cur_l->next) {
-            element_t *item, *next_item;
-            item = list_entry(cur_l, element_t, list);
-            next_item = list_entry(cur_l->next, element_t, list);
-            if (strcmp(item->value, next_item->value) < 0) {
-                report(1,
-                       "ERROR: There is at least on nodes did not follow the "
-                       "ordering rule");
+    if (k < 0 || k >= n) {
+        if (found) {
+            report(1, "ERROR: Found an element at index %d of a queue of %d",
+                   k, n);
+            ok = false;
+        }
+    } else if (!found) {
+        report(1, "ERROR: Found no element at index %d", k);
+        ok = false;
+    } else if (strcmp(found->value, values[k])) {
+        report(1, "ERROR: Found %s, but element at index %d is %s",
+               found->value, k, values[k]);
+        ok = false;
+    } else {
+        /* The queue must be partitioned around the element found */
+        i = 0;
+        for (element_t *e = q_first(current->q, &it); e;
+             e = q_next(&it), i++) {
+            int cmp = strcmp(e->value, found->value);
+            if ((i < k && cmp > 0) || (i > k && cmp < 0)) {
+                report(1, "ERROR: Queue is not partitioned around %s",
+                       found->value);
                 ok = false;
                 break;
             }
         }
+        if (ok)
+            report(1, "Element at index %d: %s", k, found->value);
     }
+    free(values);
 
     q_show(3);
     return ok && !error_check();
 }
 
-static bool do_reverseK(int argc, char *argv[])
+/* Check that the current queue is in ascending order */
+static bool check_ascending(void)
 {
-    int k = 0;
-
-    if (!current || !current->q)
-        report(3, "Warning: Calling reverseK on null queue");
-    error_check();
+    q_iter_t it;
+    element_t *e = q_first(current->q, &it), *next;
+    for (; e && (next = q_next(&it)); e = next) {
+        if (strcmp(e->value, next->value) > 0) {
+            report(1, "ERROR: Not sorted in ascending order");
+            return false;
+        }
+    }
+    return true;
+}
+
+/* insert sorted */
+static bool do_is(int argc, char *argv[])
+{
+    char randstr_buf[MAX_RANDSTR_PREFIX + MAX_RANDSTR_LEN];
+    int reps = 1;
+    bool ok = true, need_rand = false;
+    if (argc != 2 && argc != 3) {
+        report(1, "%s needs 1-2 arguments", argv[0]);
+        return false;
+    }
+
+    char *inserts = argv[1];
+    if (argc == 3) {
+        if (!get_int(argv[2], &reps)) {
+            report(1, "Invalid number of insertions '%s'", argv[2]);
+            return false;
+        }
+    }
+
+    if (!strcmp(inserts, "RAND")) {
+        need_rand = true;
+        inserts = randstr_buf;
+    }
+
+    if (!current || !current->q) {
+        report(3, "Warning: Calling insert sorted on null queue");
+        return false;
+    }
+    error_check();
+
+    /* The first insert may free stale express lanes, a block per tower. Like
+     * do_free, skip the check of each block released against every block
+     * allocated.
+     */
+    if (current->size > BIG_LIST_SIZE)
+        set_cautious_mode(false);
+    struct timespec from, to;
+    clock_gettime(CLOCK_MONOTONIC, &from);
+    if (exception_setup(true)) {
+        for (int r = 0; ok && r < reps; r++) {
+            if (need_rand)
+                fill_rand_string(randstr_buf, MAX_RANDSTR_LEN);
+            if (q_insert_sorted(current->q, inserts)) {
+                current->size++;
+                continue;
+            }
+            fail_count++;
+            if (fail_count < fail_limit)
+                report(2, "Insertion of %s failed", inserts);
+            else {
+                report(1, "ERROR: Insertion of %s failed (%d failures total)",
+                       inserts, fail_count);
+                ok = false;
+            }
+            ok = ok && !error_check();
+        }
+    }
+    exception_cancel();
+    clock_gettime(CLOCK_MONOTONIC, &to);
+    set_cautious_mode(true);
+    report(2, "Inserted in %ld us", elapsed_ns(&from, &to) / 1000);
+
+    ok = ok && check_ascending();
+    q_show(3);
+    return ok && !error_check();
+}
+
+/* Find the first element of the current queue with string s by walking it */
+static element_t *find_walk(const char *s)
+{
+    q_iter_t it;
+    for (element_t *e = q_first(current->q, &it); e; e = q_next(&it)) {
+        if (!strcmp(e->value, s))
+            return e;
+    }
+    return NULL;
+}
+
+static bool do_find(int argc, char *argv[])
+{
+    if (argc != 2) {
+        report(1, "%s takes 1 argument", argv[0]);
+        return false;
+    }
+
+    if (!current || !current->q) {
+        report(3, "Warning: Calling find on null queue");
+        return false;
+    }
+    error_check();
+
+    element_t *found = NULL;
+    set_noallocate_mode(true);
+    if (exception_setup(true))
+        found = q_find(current->q, argv[1]);
+    exception_cancel();
+    set_noallocate_mode(false);
+
+    bool ok = true;
+    element_t *e = find_walk(argv[1]);
+    if (found != e) {
+        report(1, "ERROR: Found %s, but first element with %s is %s",
+               found ? found->value : "nothing", argv[1],
+               e ? "in queue" : "not in queue");
+        ok = false;
+    } else if (found) {
+        report(1, "Found %s", found->value);
+    } else {
+        report(1, "%s not found", argv[1]);
+    }
+
+    q_show(3);
+    return ok && !error_check();
+}
+
+/* remove value */
+static bool do_rv(int argc, char *argv[])
+{
+    if (argc != 2) {
+        report(1, "%s takes 1 argument", argv[0]);
+        return false;
+    }
+
+    if (!current || !current->q) {
+        report(3, "Warning: Calling remove value on null queue");
+        return false;
+    }
+    error_check();
+
+    element_t *e = find_walk(argv[1]), *re = NULL;
+    set_noallocate_mode(true);
+    if (exception_setup(true))
+        re = q_remove_value(current->q, argv[1]);
+    exception_cancel();
+    set_noallocate_mode(false);
+
+    bool ok = true;
+    if (re != e) {
+        report(1, "ERROR: Removed %s, but first element with %s is %s",
+               re ? re->value : "nothing", argv[1],
+               e ? "in queue" : "not in queue");
+        ok = false;
+    } else if (re) {
+        report(1, "Removed %s from queue", re->value);
+    } else {
+        report(1, "%s not found", argv[1]);
+    }
+
+    if (re) {
+        current->size--;
+        q_recycle_element(current->q, re);
+    }
+    ok = ok && check_ascending();
+
+    q_show(3);
+    return ok && !error_check();
+}
+
+static bool do_dm(int argc, char *argv[])
+{
+    int reps = 1;
+    if (argc != 1 && argc != 2) {
+        report(1, "%s needs 0-1 arguments", argv[0]);
+        return false;
+    }
+
+    if (argc == 2) {
+        if (!get_int(argv[1], &reps)) {
+            report(1, "Invalid number of deletions '%s'", argv[1]);
+            return false;
+        }
+    }
+
+    if (!current || !current->q)
+        report(3, "Warning: Try to access null queue");
+    error_check();
+
+    /* As in do_free, checking each freed block against every block allocated
+     * would cost more than the deletion itself on a big queue
+     */
+    if (current && current->size > BIG_LIST_SIZE)
+        set_cautious_mode(false);
+
+    bool ok = true;
+    if (exception_setup(true)) {
+        for (int r = 0; ok && r < reps; r++) {
+            ok = q_delete_mid(current->q);
+            if (ok)
+                current->size--;
+        }
+    }
+    exception_cancel();
+    set_cautious_mode(true);
+
+    q_show(3);
+    return ok && !error_check();
+}
+
+static bool do_swap(int argc, char *argv[])
+{
+    if (argc != 1) {
+        report(1, "%s takes no arguments", argv[0]);
+        return false;
+    }
+
+    if (!current || !current->q)
+        report(3, "Warning: Try to access null queue");
+    error_check();
+
+    set_noallocate_mode(true);
+    if (exception_setup(true))
+        q_swap(current->q);
+    exception_cancel();
+
+    set_noallocate_mode(false);
+
+    q_show(3);
+    return !error_check();
+}
+
+static bool do_descend(int argc, char *argv[])
+{
+    if (argc != 1) {
+        report(1, "%s takes too much arguments", argv[0]);
+        return false;
+    }
+
+    if (!current || !current->q)
+        report(3, "Warning: Calling ascend on null queue");
+    error_check();
+
+
+    int cnt = q_size(current->q);
+    if (cnt < 2)
+        report(3, "Warning: Calling ascend on single node");
+    error_check();
+
+    if (exception_setup(true))
+        current->size = q_descend(current->q);
+    set_noallocate_mode(false);
+
+    bool ok = true;
+
+    cnt = current->size;
+    if (current->size) {
+        q_iter_t it;
+        element_t *item = q_first(current->q, &it), *next_item;
+        for (; item && --cnt && (next_item = q_next(&it)); item = next_item) {
+            if (strcmp(item->value, next_item->value) < 0) {
+                report(1,
+                       "ERROR: There is at least on nodes did not follow the "
+                       "ordering rule");
+                ok = false;
+                break;
+            }
+        }
+    }
+
+    q_show(3);
+    return ok && !error_check();
+}
+
+static bool do_reverseK(int argc, char *argv[])
+{
+    int k = 0;
+
+    if (!current || !current->q)
+        report(3, "Warning: Calling reverseK on null queue");
+    error_check();
 
     if (argc == 2) {
         if (!get_int(argv[1], &k)) {
@@ -785,6 +1560,786 @@ static bool do_reverseK(int argc, char *argv[])
     return !error_check();
 }
 
+/* Start a thread running fn(arg) with all signals blocked, keeping them on
+ * this thread as sort_tasks_run() does: their handlers may longjmp into it.
+ */
+static bool thread_start(pthread_t *thread, void *(*fn)(void *), void *arg)
+{
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &old);
+    bool ok = !pthread_create(thread, NULL, fn, arg);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    return ok;
+}
+
+/* Stress of the lock-free queue of mpmc.c: each producer inserts its own
+ * elements, numbered in order, and consumers remove them all. An element is
+ * known from its index in the block of all of them.
+ */
+typedef struct {
+    mpmc_t *q;
+    element_t *elements;
+    int id, count;      /* producer: first element, and number of them */
+    long *latency;      /* ns spent in each successful call */
+    int *popped;        /* consumer: indexes of the elements removed */
+    int done;           /* number of entries in latency and popped */
+    atomic_int *left;   /* elements not removed yet */
+    atomic_bool failed; /* an insert failed, for lack of memory */
+    pthread_t thread;
+} mpmc_worker_t;
+
+static void *mpmc_produce(void *arg)
+{
+    mpmc_worker_t *w = arg;
+    mpmc_thread_t *t = mpmc_join(w->q);
+
+    for (int i = 0; i < w->count; i++) {
+        struct timespec from, to;
+        clock_gettime(CLOCK_MONOTONIC, &from);
+        bool ok = mpmc_insert_tail(w->q, t, &w->elements[w->id + i]);
+        clock_gettime(CLOCK_MONOTONIC, &to);
+        if (!ok) {
+            /* Consumers wait for the element, they must not */
+            atomic_fetch_sub(w->left, w->count - i);
+            atomic_store(&w->failed, true);
+            break;
+        }
+        w->latency[w->done++] = elapsed_ns(&from, &to);
+    }
+    return NULL;
+}
+
+static void *mpmc_consume(void *arg)
+{
+    mpmc_worker_t *w = arg;
+    mpmc_thread_t *t = mpmc_join(w->q);
+
+    while (atomic_load(w->left) > 0) {
+        struct timespec from, to;
+        clock_gettime(CLOCK_MONOTONIC, &from);
+        element_t *e = mpmc_remove_head(w->q, t);
+        clock_gettime(CLOCK_MONOTONIC, &to);
+        if (!e)
+            continue;
+        atomic_fetch_sub(w->left, 1);
+        w->latency[w->done] = elapsed_ns(&from, &to);
+        w->popped[w->done++] = e - w->elements;
+    }
+    return NULL;
+}
+
+static int long_cmp(const void *a, const void *b)
+{
+    long x = *(const long *) a, y = *(const long *) b;
+    return (x > y) - (x < y);
+}
+
+/* 99th percentile of the latencies of the workers, which it sorts */
+static long mpmc_p99(mpmc_worker_t *workers, int nr, long *all)
+{
+    int n = 0;
+    for (int i = 0; i < nr; i++) {
+        memcpy(all + n, workers[i].latency, workers[i].done * sizeof(long));
+        n += workers[i].done;
+    }
+    if (!n)
+        return 0;
+    qsort(all, n, sizeof(long), long_cmp);
+    return all[(int) ((long) n * 99 / 100)];
+}
+
+/* Check that every element was removed once, and each consumer removed the
+ * elements of a producer in the order they were inserted.
+ */
+static bool mpmc_check(mpmc_worker_t *consumers, int nr, int producers, int n)
+{
+    int total = producers * n;
+    char *seen = calloc(total, 1);
+    int *last = malloc(producers * sizeof(int));
+    bool ok = seen && last;
+
+    for (int c = 0; ok && c < nr; c++) {
+        for (int p = 0; p < producers; p++)
+            last[p] = -1;
+        for (int i = 0; ok && i < consumers[c].done; i++) {
+            int idx = consumers[c].popped[i];
+            if (idx < 0 || idx >= total || seen[idx]++) {
+                report(1, "ERROR: Element %d removed more than once", idx);
+                ok = false;
+            } else if (idx % n <= last[idx / n]) {
+                report(1,
+                       "ERROR: Element %d of producer %d removed after "
+                       "element %d",
+                       idx % n, idx / n, last[idx / n]);
+                ok = false;
+            } else {
+                last[idx / n] = idx % n;
+            }
+        }
+    }
+    for (int i = 0; ok && i < total; i++) {
+        if (!seen[i]) {
+            report(1, "ERROR: Element %d of producer %d never removed", i % n,
+                   i / n);
+            ok = false;
+        }
+    }
+    free(seen);
+    free(last);
+    return ok;
+}
+
+static bool do_mpmc(int argc, char *argv[])
+{
+    if (argc != 3 && argc != 4) {
+        report(1, "%s takes 2-3 arguments", argv[0]);
+        return false;
+    }
+
+    int producers, consumers, n = 100000;
+    if (!get_int(argv[1], &producers) || !get_int(argv[2], &consumers) ||
+        (argc == 4 && !get_int(argv[3], &n))) {
+        report(1, "Invalid arguments to %s", argv[0]);
+        return false;
+    }
+    if (producers < 1 || consumers < 1 || n < 1 ||
+        producers + consumers >= MPMC_MAX_THREADS ||
+        (long) producers * n > INT_MAX) {
+        report(1,
+               "Need 2 to %d producers and consumers in all, and at least one "
+               "element each",
+               MPMC_MAX_THREADS - 1);
+        return false;
+    }
+
+    int total = producers * n, nr = producers + consumers;
+    atomic_int left = total;
+    mpmc_t *q = mpmc_new();
+    element_t *elements = malloc(total * sizeof(element_t));
+    mpmc_worker_t *workers = calloc(nr, sizeof(mpmc_worker_t));
+    long *scratch = malloc(total * sizeof(long));
+    bool ok = q && elements && workers && scratch;
+    for (int i = 0; ok && i < nr; i++) {
+        mpmc_worker_t *w = &workers[i];
+        w->q = q;
+        w->elements = elements;
+        w->left = &left;
+        atomic_init(&w->failed, false);
+        if (i < producers) {
+            w->id = i * n;
+            w->count = n;
+            w->latency = malloc(n * sizeof(long));
+            ok = w->latency;
+        } else {
+            /* A consumer may remove every element */
+            w->latency = malloc(total * sizeof(long));
+            w->popped = malloc(total * sizeof(int));
+            ok = w->latency && w->popped;
+        }
+    }
+    if (!ok) {
+        report(1, "ERROR: Could not allocate %d elements", total);
+        goto out;
+    }
+    for (int i = 0; i < total; i++)
+        elements[i].value = "mpmc";
+
+    struct timespec from, to;
+    int spawned = 0;
+    clock_gettime(CLOCK_MONOTONIC, &from);
+    for (; spawned < nr; spawned++) {
+        mpmc_worker_t *w = &workers[spawned];
+        if (!thread_start(&w->thread,
+                          spawned < producers ? mpmc_produce : mpmc_consume,
+                          w))
+            break;
+    }
+    /* Out of threads: let the consumers started stop */
+    if (spawned < nr)
+        atomic_store(&left, 0);
+    for (int i = 0; i < spawned; i++)
+        pthread_join(workers[i].thread, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &to);
+
+    if (spawned < nr) {
+        report(1, "ERROR: Could only start %d threads out of %d", spawned, nr);
+        ok = false;
+        goto out;
+    }
+    for (int i = 0; i < producers; i++) {
+        if (atomic_load(&workers[i].failed)) {
+            report(1, "ERROR: Producer %d could not allocate a node", i);
+            ok = false;
+            goto out;
+        }
+    }
+    if (mpmc_remove_head(q, mpmc_join(q))) {
+        report(1, "ERROR: Queue not empty after removing %d elements", total);
+        ok = false;
+        goto out;
+    }
+    ok = mpmc_check(workers + producers, consumers, producers, n);
+
+    double secs = elapsed_ns(&from, &to) / 1e9;
+    report(1, "P=%d C=%d: %.0f ops/sec", producers,
+           consumers, 2.0 * total / secs);
+    report(1, "p99 latency: insert %ld ns, remove %ld ns",
+           mpmc_p99(workers, producers, scratch),
+           mpmc_p99(workers + producers, consumers, scratch));
+
+out:
+    for (int i = 0; workers && i < nr; i++) {
+        free(workers[i].latency);
+        free(workers[i].popped);
+    }
+    mpmc_free(q);
+    free(elements);
+    free(workers);
+    free(scratch);
+    return ok;
+}
+
+/* Benchmark of the ring of spsc.c against a queue behind a mutex: a producer
+ * thread passes n elements to a consumer thread, batch at a time.
+ */
+#define SPSC_SLOTS 1024
+
+typedef struct {
+    spsc_t *ring;             /* the ring, or NULL for the queue */
+    element_t **elements;     /* element i holds string i */
+    struct list_head *q;      /* the queue, or NULL for the ring */
+    pthread_mutex_t lock;     /* guarding q */
+    char (*names)[16];        /* string i, decimal i */
+    int n, batch;
+    int bad;                  /* index of an element out of order, or -1 */
+} spsc_bench_t;
+
+static void *spsc_produce(void *arg)
+{
+    spsc_bench_t *b = arg;
+
+    for (int i = 0; i < b->n;) {
+        int k = b->n - i < b->batch ? b->n - i : b->batch;
+        if (b->ring) {
+            k = spsc_insert_n(b->ring, b->elements + i, k);
+        } else {
+            pthread_mutex_lock(&b->lock);
+            for (int j = 0; j < k; j++) {
+                if (!q_insert_tail(b->q, b->names[i + j])) {
+                    k = j;
+                    break;
+                }
+            }
+            pthread_mutex_unlock(&b->lock);
+        }
+        if (!k)
+            sched_yield(); /* full, or out of memory */
+        i += k;
+    }
+    return NULL;
+}
+
+static void *spsc_consume(void *arg)
+{
+    spsc_bench_t *b = arg;
+    element_t **got = malloc(b->batch * sizeof(element_t *));
+    char value[16];
+
+    for (int i = 0; got && i < b->n;) {
+        int k = 0;
+        if (b->ring) {
+            k = spsc_remove_n(b->ring, got, b->batch);
+            for (int j = 0; j < k; j++) {
+                if (got[j] != b->elements[i + j] && b->bad < 0)
+                    b->bad = i + j;
+            }
+        } else {
+            pthread_mutex_lock(&b->lock);
+            for (; k < b->batch; k++) {
+                element_t *e = q_remove_head(b->q, value, sizeof(value));
+                if (!e)
+                    break;
+                if (strcmp(value, b->names[i + k]) && b->bad < 0)
+                    b->bad = i + k;
+                q_release_element(e);
+            }
+            pthread_mutex_unlock(&b->lock);
+        }
+        if (!k)
+            sched_yield(); /* empty */
+        i += k;
+    }
+    if (!got)
+        b->bad = 0;
+    free(got);
+    return NULL;
+}
+
+/* Run the benchmark b, producing on this thread, and report how fast it went */
+static bool spsc_run(spsc_bench_t *b, const char *name)
+{
+    pthread_t consumer;
+    struct timespec from, to;
+
+    b->bad = -1;
+    clock_gettime(CLOCK_MONOTONIC, &from);
+    if (!thread_start(&consumer, spsc_consume, b)) {
+        report(1, "ERROR: Could not start consumer thread");
+        return false;
+    }
+    spsc_produce(b);
+    pthread_join(consumer, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &to);
+
+    if (b->bad >= 0) {
+        report(1, "ERROR: Element %d removed out of order", b->bad);
+        return false;
+    }
+    report(1, "%s: %.0f ops/sec", name,
+           2.0 * b->n / (elapsed_ns(&from, &to) / 1e9));
+    return true;
+}
+
+static bool do_spsc(int argc, char *argv[])
+{
+    if (argc != 2 && argc != 3) {
+        report(1, "%s takes 1-2 arguments", argv[0]);
+        return false;
+    }
+
+    int n, batch = 1;
+    if (!get_int(argv[1], &n) || (argc == 3 && !get_int(argv[2], &batch))) {
+        report(1, "Invalid arguments to %s", argv[0]);
+        return false;
+    }
+    if (n < 1 || batch < 1) {
+        report(1, "Need at least one element, batch at a time");
+        return false;
+    }
+    if (batch > n)
+        batch = n;
+
+    spsc_bench_t b = {.n = n, .batch = batch};
+    element_t *elements = malloc(n * sizeof(element_t));
+    b.elements = malloc(n * sizeof(element_t *));
+    b.names = malloc(n * sizeof(*b.names));
+    b.ring = spsc_new(SPSC_SLOTS);
+    bool ok = elements && b.elements && b.names && b.ring;
+    if (!ok) {
+        report(1, "ERROR: Could not allocate %d elements", n);
+        goto out;
+    }
+    for (int i = 0; i < n; i++) {
+        snprintf(b.names[i], sizeof(*b.names), "%d", i);
+        elements[i].value = b.names[i];
+        b.elements[i] = &elements[i];
+    }
+    report(1, "%d elements, %d at a time", n, batch);
+    ok = spsc_run(&b, "ring");
+    spsc_free(b.ring);
+    b.ring = NULL;
+    if (!ok)
+        goto out;
+
+    /* The queue allocates with test_malloc. Keep its failures on purpose,
+     * which would stall the producer, and like do_free the check of each
+     * block freed against every block allocated out of the measure.
+     */
+    int probability = fail_probability;
+    fail_probability = 0;
+    set_cautious_mode(false);
+    b.q = q_new();
+    pthread_mutex_init(&b.lock, NULL);
+    ok = b.q && spsc_run(&b, "locked queue");
+    if (!b.q)
+        report(1, "ERROR: Could not allocate queue");
+    pthread_mutex_destroy(&b.lock);
+    q_free(b.q);
+    set_cautious_mode(true);
+    fail_probability = probability;
+
+out:
+    spsc_free(b.ring);
+    free(elements);
+    free(b.elements);
+    free(b.names);
+    return ok && !error_check();
+}
+
+/* Scaling of the sharded pool of shard.c: threads of even id insert n
+ * elements each into their shard, and every thread removes n / 4, so that odd
+ * ones have to steal. What is left is drained in order.
+ */
+typedef struct {
+    sharded_t *s;
+    element_t *elements;
+    int id, inserts, removes;
+    int *popped; /* indexes of the elements removed */
+    pthread_t thread;
+} shard_worker_t;
+
+static void *shard_work(void *arg)
+{
+    shard_worker_t *w = arg;
+
+    for (int i = 0; i < w->inserts; i++)
+        shard_insert(w->s, w->id,
+                     &w->elements[w->id / 2 * w->inserts + i]);
+    for (int i = 0; i < w->removes;) {
+        element_t *e = shard_remove(w->s, w->id);
+        if (!e) {
+            sched_yield(); /* the producers are not done yet */
+            continue;
+        }
+        w->popped[i++] = e - w->elements;
+    }
+    return NULL;
+}
+
+/* Check that every element inserted was either removed or drained, once, and
+ * that the drained ones come in ascending order.
+ */
+static bool shard_check(shard_worker_t *workers,
+                        int nr,
+                        int total,
+                        element_t *elements,
+                        struct list_head *drained)
+{
+    char *seen = calloc(total, 1);
+    bool ok = seen;
+
+    for (int t = 0; ok && t < nr; t++) {
+        for (int i = 0; ok && i < workers[t].removes; i++) {
+            if (seen[workers[t].popped[i]]++) {
+                report(1, "ERROR: Element %d removed more than once",
+                       workers[t].popped[i]);
+                ok = false;
+            }
+        }
+    }
+
+    element_t *e, *prev = NULL;
+    list_for_each_entry (e, drained, list) {
+        if (!ok)
+            break;
+        if (seen[e - elements]++) {
+            report(1, "ERROR: Element %d drained after being removed",
+                   (int) (e - elements));
+            ok = false;
+        } else if (prev && strcmp(prev->value, e->value) > 0) {
+            report(1, "ERROR: Drained elements not in ascending order");
+            ok = false;
+        }
+        prev = e;
+    }
+    for (int i = 0; ok && i < total; i++) {
+        if (!seen[i]) {
+            report(1, "ERROR: Element %d lost", i);
+            ok = false;
+        }
+    }
+    free(seen);
+    return ok;
+}
+
+static bool do_shard(int argc, char *argv[])
+{
+    if (argc != 2 && argc != 3) {
+        report(1, "%s takes 1-2 arguments", argv[0]);
+        return false;
+    }
+
+    int nr, n = 100000;
+    if (!get_int(argv[1], &nr) || (argc == 3 && !get_int(argv[2], &n))) {
+        report(1, "Invalid arguments to %s", argv[0]);
+        return false;
+    }
+    if (nr < 1 || nr > MPMC_MAX_THREADS || n < 4 ||
+        (long) (nr + 1) / 2 * n > INT_MAX) {
+        report(1, "Need 1 to %d threads, and at least 4 elements each",
+               MPMC_MAX_THREADS);
+        return false;
+    }
+
+    int producers = (nr + 1) / 2, total = producers * n;
+    sharded_t *s = shard_new(nr);
+    element_t *elements = malloc(total * sizeof(element_t));
+    char(*names)[16] = malloc(total * sizeof(*names));
+    shard_worker_t *workers = calloc(nr, sizeof(shard_worker_t));
+    bool ok = s && elements && names && workers;
+    for (int i = 0; ok && i < nr; i++) {
+        shard_worker_t *w = &workers[i];
+        w->s = s;
+        w->elements = elements;
+        w->id = i;
+        /* Thread 2k inserts elements k * n to k * n + n - 1 */
+        w->inserts = i % 2 ? 0 : n;
+        w->removes = n / 4;
+        w->popped = malloc(w->removes * sizeof(int));
+        ok = w->popped;
+    }
+    if (!ok) {
+        report(1, "ERROR: Could not allocate %d elements", total);
+        goto out;
+    }
+    for (int i = 0; i < total; i++) {
+        snprintf(names[i], sizeof(*names), "%d", i);
+        elements[i].value = names[i];
+    }
+
+    struct timespec from, to;
+    int spawned = 0;
+    clock_gettime(CLOCK_MONOTONIC, &from);
+    for (; spawned < nr; spawned++) {
+        if (!thread_start(&workers[spawned].thread, shard_work,
+                          &workers[spawned]))
+            break;
+    }
+    /* Out of threads: do their work here, inserts first */
+    for (int i = spawned; i < nr; i++) {
+        for (int j = 0; j < workers[i].inserts; j++)
+            shard_insert(s, i, &elements[i / 2 * n + j]);
+        workers[i].inserts = 0;
+    }
+    for (int i = spawned; i < nr; i++)
+        shard_work(&workers[i]);
+    for (int i = 0; i < spawned; i++)
+        pthread_join(workers[i].thread, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &to);
+
+    LIST_HEAD(drained);
+    int left = shard_drain(s, &drained);
+    ok = shard_check(workers, nr, total, elements, &drained);
+
+    report(1, "%d threads: %.0f ops/sec, %d elements drained", nr,
+           (total + nr * (n / 4)) / (elapsed_ns(&from, &to) / 1e9), left);
+
+out:
+    for (int i = 0; workers && i < nr; i++)
+        free(workers[i].popped);
+    shard_free(s);
+    free(elements);
+    free(names);
+    free(workers);
+    return ok;
+}
+
+/* Point element e, built outside of any queue, to string value. The pairing
+ * heap orders elements with element_cmp(), which reads their key too.
+ */
+static void pq_element_init(element_t *e, char *value)
+{
+    e->value = value;
+#ifdef QUEUE_KEY_PREFIX
+    e->key = key_prefix(value);
+#endif
+}
+
+/* Insert n strings batch at a time, each time removing half as many, the
+ * smallest first, then remove the rest: through a pairing heap, and through a
+ * queue sorted after each batch of inserts. The strings removed, in order,
+ * go to out.
+ */
+typedef struct {
+    int n, batch;
+    char (*names)[16];
+    element_t *elements;
+    const char **out;
+    char (*copies)[16];
+} pq_bench_t;
+
+static void pq_heap_run(pq_bench_t *b)
+{
+    pheap_t h;
+    int done = 0;
+    pheap_init(&h);
+    for (int i = 0; i < b->n;) {
+        for (int j = 0; j < b->batch && i < b->n; j++, i++)
+            pheap_insert(&h, &b->elements[i]);
+        for (int j = 0; j < b->batch / 2 && h.size; j++)
+            b->out[done++] = pheap_remove_min(&h)->value;
+    }
+    while (h.size)
+        b->out[done++] = pheap_remove_min(&h)->value;
+    report(2, "Comparisons per element = %.2f", (double) h.compares / b->n);
+}
+
+static bool pq_queue_run(pq_bench_t *b)
+{
+    struct list_head *q = q_new();
+    int done = 0;
+    bool ok = q;
+    for (int i = 0; ok && i < b->n;) {
+        for (int j = 0; ok && j < b->batch && i < b->n; j++, i++)
+            ok = q_insert_tail(q, b->names[i]);
+        q_sort(q);
+        for (int j = 0; ok && j < b->batch / 2 && !list_empty(q); j++) {
+            b->out[done] = b->copies[done];
+            q_release_element(q_remove_head(q, b->copies[done++], 16));
+        }
+    }
+    while (ok && !list_empty(q)) {
+        b->out[done] = b->copies[done];
+        q_release_element(q_remove_head(q, b->copies[done++], 16));
+    }
+    q_free(q);
+    return ok;
+}
+
+static bool do_pq(int argc, char *argv[])
+{
+    if (argc != 2 && argc != 3) {
+        report(1, "%s takes 1-2 arguments", argv[0]);
+        return false;
+    }
+
+    int n, batch = 16;
+    if (!get_int(argv[1], &n) || (argc == 3 && !get_int(argv[2], &batch))) {
+        report(1, "Invalid arguments to %s", argv[0]);
+        return false;
+    }
+    if (n < 1 || batch < 1) {
+        report(1, "Need at least one element, batch at a time");
+        return false;
+    }
+
+    pq_bench_t b = {.n = n, .batch = batch};
+    b.names = malloc(n * sizeof(*b.names));
+    b.elements = malloc(n * sizeof(element_t));
+    b.copies = malloc(n * sizeof(*b.copies));
+    const char **heap_out = malloc(n * sizeof(char *));
+    const char **queue_out = malloc(n * sizeof(char *));
+    bool ok = b.names && b.elements && b.copies && heap_out && queue_out;
+    if (!ok) {
+        report(1, "ERROR: Could not allocate %d elements", n);
+        goto out;
+    }
+    for (int i = 0; i < n; i++) {
+        snprintf(b.names[i], sizeof(*b.names), "%08x", (unsigned) rand());
+        pq_element_init(&b.elements[i], b.names[i]);
+    }
+    report(1, "%d elements, %d at a time", n, batch);
+
+    struct timespec from, to;
+    b.out = heap_out;
+    clock_gettime(CLOCK_MONOTONIC, &from);
+    pq_heap_run(&b);
+    clock_gettime(CLOCK_MONOTONIC, &to);
+    report(1, "pairing heap: %ld us", elapsed_ns(&from, &to) / 1000);
+
+    /* Like do_spsc, keep the failures of test_malloc and the check of each
+     * block freed against every block allocated out of the queue run
+     */
+    int probability = fail_probability;
+    fail_probability = 0;
+    set_cautious_mode(false);
+    b.out = queue_out;
+    clock_gettime(CLOCK_MONOTONIC, &from);
+    ok = pq_queue_run(&b);
+    clock_gettime(CLOCK_MONOTONIC, &to);
+    set_cautious_mode(true);
+    fail_probability = probability;
+    if (!ok) {
+        report(1, "ERROR: Could not insert into queue");
+        goto out;
+    }
+    report(1, "sorted queue: %ld us", elapsed_ns(&from, &to) / 1000);
+
+    for (int i = 0; i < n; i++) {
+        if (strcmp(heap_out[i], queue_out[i])) {
+            report(1, "ERROR: Removal %d got %s from the heap, but %s", i,
+                   heap_out[i], queue_out[i]);
+            ok = false;
+            break;
+        }
+    }
+
+out:
+    free(b.names);
+    free(b.elements);
+    free(b.copies);
+    free(heap_out);
+    free(queue_out);
+    return ok && !error_check();
+}
+
+/* Pairing heap of the pqi and pqr commands, its elements owned by qtest */
+static pheap_t pq_heap;
+
+/* insert into heap */
+static bool do_pqi(int argc, char *argv[])
+{
+    char randstr_buf[MAX_RANDSTR_PREFIX + MAX_RANDSTR_LEN];
+    int reps = 1;
+    if (argc != 2 && argc != 3) {
+        report(1, "%s needs 1-2 arguments", argv[0]);
+        return false;
+    }
+
+    char *inserts = argv[1];
+    if (argc == 3 && !get_int(argv[2], &reps)) {
+        report(1, "Invalid number of insertions '%s'", argv[2]);
+        return false;
+    }
+
+    bool need_rand = !strcmp(inserts, "RAND");
+    if (need_rand)
+        inserts = randstr_buf;
+
+    for (int r = 0; r < reps; r++) {
+        if (need_rand)
+            fill_rand_string(randstr_buf, MAX_RANDSTR_LEN);
+        element_t *e = malloc(sizeof(element_t));
+        char *value = strdup(inserts);
+        if (!e || !value) {
+            free(e);
+            free(value);
+            report(1, "INTERNAL ERROR.  Could not allocate heap element");
+            return false;
+        }
+        pq_element_init(e, value);
+        pheap_insert(&pq_heap, e);
+    }
+    report(3, "Heap size = %d", pq_heap.size);
+    return true;
+}
+
+/* remove smallest from heap */
+static bool do_pqr(int argc, char *argv[])
+{
+    if (argc != 1 && argc != 2) {
+        report(1, "%s needs 0-1 arguments", argv[0]);
+        return false;
+    }
+
+    element_t *e = pheap_remove_min(&pq_heap);
+    if (!e) {
+        report(1, "ERROR: Removal from empty heap");
+        return false;
+    }
+
+    bool ok = true;
+    report(2, "Removed %s from heap", e->value);
+    if (argc == 2 && strcmp(e->value, argv[1])) {
+        report(1, "ERROR: Removed value %s != expected value %s", e->value,
+               argv[1]);
+        ok = false;
+    }
+    /* What is left must not hold a smaller string */
+    if (pq_heap.root &&
+        strcmp(list_entry(pq_heap.root, element_t, list)->value, e->value) <
+            0) {
+        report(1, "ERROR: Heap holds %s, smaller than %s removed",
+               list_entry(pq_heap.root, element_t, list)->value, e->value);
+        ok = false;
+    }
+    free(e->value);
+    free(e);
+    report(3, "Heap size = %d", pq_heap.size);
+    return ok;
+}
+
 static bool do_merge(int argc, char *argv[])
 {
     if (argc != 1) {
@@ -805,11 +2360,16 @@ static bool do_merge(int argc, char *argv[])
     exception_cancel();
     set_noallocate_mode(false);
 
-    if (q_size(&chain.head) > 1) {
+    if (chain.size > 1) {
         chain.size = 1;
         current = list_entry(chain.head.next, queue_contex_t, chain);
         current->size = len;
 
+        /* Like do_free, skip the check of each block against every block
+         * allocated, which would make freeing k queues O(k * len)
+         */
+        if (len > BIG_LIST_SIZE)
+            set_cautious_mode(false);
         struct list_head *cur = chain.head.next->next;
         while ((uintptr_t) cur != (uintptr_t) &chain.head) {
             queue_contex_t *ctx = list_entry(cur, queue_contex_t, chain);
@@ -817,6 +2377,7 @@ static bool do_merge(int argc, char *argv[])
             q_free(ctx->q);
             free(ctx);
         }
+        set_cautious_mode(true);
 
         chain.head.prev = &current->chain;
         current->chain.next = &chain.head;
@@ -824,12 +2385,10 @@ static bool do_merge(int argc, char *argv[])
 
     bool ok = true;
     if (current && current->size) {
-        for (struct list_head *cur_l = current->q->next;
-             cur_l != current->q && --len; cur_l = cur_l->next) {
+        q_iter_t it;
+        element_t *item = q_first(current->q, &it), *next_item;
+        for (; item && --len && (next_item = q_next(&it)); item = next_item) {
             /* Ensure each element in ascending order */
-            element_t *item, *next_item;
-            item = list_entry(cur_l, element_t, list);
-            next_item = list_entry(cur_l->next, element_t, list);
             if (strcmp(item->value, next_item->value) > 0) {
                 report(1,
                        "ERROR: Not sorted in ascending order (It might because "
@@ -882,12 +2441,11 @@ static bool q_show(int vlevel)
 
     report_noreturn(vlevel, "l = [");
 
-    struct list_head *ori = current->q;
-    struct list_head *cur = current->q->next;
+    q_iter_t it;
+    element_t *e = q_first(current->q, &it);
 
     if (exception_setup(true)) {
-        while (ok && ori != cur && cnt < current->size) {
-            element_t *e = list_entry(cur, element_t, list);
+        while (ok && e && cnt < current->size) {
             if (cnt < BIG_LIST_SIZE) {
                 report_noreturn(vlevel, cnt == 0 ? "%s" : " %s", e->value);
                 if (show_entropy) {
@@ -897,7 +2455,7 @@ static bool q_show(int vlevel)
                 }
             }
             cnt++;
-            cur = cur->next;
+            e = q_next(&it);
             ok = ok && !error_check();
         }
     }
@@ -908,7 +2466,7 @@ static bool q_show(int vlevel)
         return false;
     }
 
-    if (cur == ori) {
+    if (!e) {
         if (cnt <= BIG_LIST_SIZE)
             report(vlevel, "]");
         else
@@ -1004,11 +2562,37 @@ static void console_init()
         rt,
         "Remove from tail of queue. Optionally compare to expected value str",
         "[str]");
+    ADD_COMMAND(rhn, "Remove n elements from head of queue at once", "n");
+    ADD_COMMAND(rtn, "Remove n elements from tail of queue at once", "n");
+    ADD_COMMAND(churn,
+                "Insert string str at tail of queue and remove head n times",
+                "str n");
+    ADD_COMMAND(mem,
+                "Show bytes allocated, their peak and blocks handed out since "
+                "last call",
+                "");
+    ADD_COMMAND(is,
+                "Insert string str into sorted queue, keeping it sorted, n "
+                "times. Generate random string(s) if str equals RAND. "
+                "(default: n == 1)",
+                "str [n]");
+    ADD_COMMAND(find, "Find element with string str in sorted queue", "str");
+    ADD_COMMAND(rv, "Remove element with string str from sorted queue",
+                "str");
     ADD_COMMAND(reverse, "Reverse queue", "");
     ADD_COMMAND(sort, "Sort queue in ascending order", "");
+    ADD_COMMAND(sortunique,
+                "Sort queue in ascending order and delete all nodes that have "
+                "duplicate string, in one pass",
+                "");
+    ADD_COMMAND(select,
+                "Find the element at index k of queue once sorted, by "
+                "partitioning it",
+                "k");
     ADD_COMMAND(size, "Compute queue size n times (default: n == 1)", "[n]");
     ADD_COMMAND(show, "Show queue contents", "");
-    ADD_COMMAND(dm, "Delete middle node in queue", "");
+    ADD_COMMAND(dm, "Delete middle node in queue n times (default: n == 1)",
+                "[n]");
     ADD_COMMAND(dedup, "Delete all nodes that have duplicate string", "");
     ADD_COMMAND(merge, "Merge all the queues into one sorted queue", "");
     ADD_COMMAND(swap, "Swap every two adjacent nodes in queue", "");
@@ -1018,12 +2602,65 @@ static void console_init()
                 "");
     ADD_COMMAND(reverseK, "Reverse the nodes of the queue 'K' at a time",
                 "[K]");
+    ADD_COMMAND(mpmc,
+                "Pass n elements from each of P producer threads to C "
+                "consumer threads through a lock-free queue. Report ops/sec "
+                "and p99 latency (default: n == 100000)",
+                "P C [n]");
+    ADD_COMMAND(spsc,
+                "Pass n elements from a producer thread to a consumer thread "
+                "batch at a time, through a ring and through a queue behind a "
+                "mutex. Report ops/sec of each (default: batch == 1)",
+                "n [batch]");
+    ADD_COMMAND(shard,
+                "Insert n elements from each even thread out of T into their "
+                "own shards, remove n / 4 from each thread, stealing when "
+                "empty, and drain the rest in order. Report ops/sec "
+                "(default: n == 100000)",
+                "T [n]");
+    ADD_COMMAND(pq,
+                "Insert n random strings batch at a time, removing half as "
+                "many smallest first after each batch, through a pairing heap "
+                "and through a queue sorted after each batch. Report time of "
+                "each (default: batch == 16)",
+                "n [batch]");
+    ADD_COMMAND(pqi,
+                "Insert string str into the pairing heap n times. Generate "
+                "random string(s) if str equals RAND. (default: n == 1)",
+                "str [n]");
+    ADD_COMMAND(pqr,
+                "Remove the smallest string from the pairing heap. Optionally "
+                "compare to expected value str",
+                "[str]");
     add_param("length", &string_length, "Maximum length of displayed string",
               NULL);
     add_param("malloc", &fail_probability, "Malloc failure probability percent",
               NULL);
     add_param("fail", &fail_limit,
               "Number of times allow queue operations to return false", NULL);
+    add_param("sort", &sort_algo,
+              "Sorting algorithm (0: list_sort, 1: top-down merge sort, 2: "
+              "adaptive merge sort, 3: MSD radix sort)",
+              NULL);
+    add_param("threads", &sort_threads, "Number of threads sort runs on",
+              NULL);
+    add_param("sizecheck", &size_check,
+              "Check the cached queue size against a walk of the list", NULL);
+    add_param("prefix", &rand_prefix,
+              "Length of the prefix shared by RAND strings", NULL);
+    add_param("bulk", &use_bulk,
+              "Use the bulk API for ih and it with a count, rhn and rtn", NULL);
+    add_param("randdup", &rand_dup,
+              "Percent of RAND strings which repeat a recent one", NULL);
+    add_param("hashdedup", &dedup_hash,
+              "Have dedup delete duplicates anywhere in the queue, not only "
+              "adjacent ones",
+              NULL);
+    add_param("recycle", &recycle_limit,
+              "Number of removed elements each queue keeps for reuse", NULL);
+    add_param("skiplist", &skip_index,
+              "Have is, find and rv keep a skip list over the sorted queue",
+              NULL);
 }
 
 /* Signal handlers */
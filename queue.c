@@ -3,6 +3,11 @@
 #include <string.h>
 
 #include "queue.h"
+#include "queue_element.h"
+#include "queue_hash.h"
+#include "queue_sort.h"
+#include "report.h"
+#include "skiplist.h"
 
 /* Notice: sometimes, Cppcheck would find the potential NULL pointer bugs,
  * but some of them cannot occur. You can suppress them by adding the
@@ -10,50 +15,513 @@
  *   cppcheck-suppress nullPointer
  */
 
+/* Have q_size() check the cached size against a walk of the list */
+int size_check = 0;
+
+/* Have the sorted operations keep express lanes over the list */
+int skip_index = 0;
+
+/**
+ * queue_t - Header of a queue
+ * @head: list head handed out by q_new(), must stay the first member
+ * @size: number of elements, kept up to date by every operation
+ * @mid: node at index size / 2, or NULL if not known (QUEUE_MIDDLE_FINGER only)
+ * @reversed: the queue runs from the tail of the list (QUEUE_LAZY_REVERSE only)
+ * @store: storage of the elements, and those released for reuse
+ * @skip: express lanes over the list while it is sorted, or NULL
+ * @skip_stale: @skip no longer matches the list, and waits to be freed
+ *
+ * Inserts and removes at either end move @mid by at most one node, depending
+ * on the parity of @size. Operations reordering the queue forget it, and
+ * q_delete_mid() finds it again with a walk. @mid counts from the head of the
+ * list, whatever @reversed says.
+ *
+ * q_reverse() just flips @reversed, and the ends of the queue swap. Operations
+ * which walk the queue in order relink the list first, see queue_unreverse().
+ */
+typedef struct {
+    struct list_head head;
+    int size;
+#ifdef QUEUE_MIDDLE_FINGER
+    struct list_head *mid;
+#endif
+#ifdef QUEUE_LAZY_REVERSE
+    bool reversed;
+#endif
+    element_store_t store;
+    skiplist_t *skip;
+    bool skip_stale;
+} queue_t;
+
+static inline queue_t *to_queue(struct list_head *head)
+{
+    return container_of(head, queue_t, head);
+}
+
+element_store_t *queue_store(struct list_head *head)
+{
+    return &to_queue(head)->store;
+}
+
+#ifdef QUEUE_MIDDLE_FINGER
+/* Follow a node added at the head (at_head) or the tail of q, after size is
+ * incremented.
+ */
+static inline void finger_add(queue_t *q, bool at_head)
+{
+    if (q->size == 1)
+        q->mid = q->head.next;
+    else if (q->mid && at_head && (q->size & 1))
+        q->mid = q->mid->prev;
+    else if (q->mid && !at_head && !(q->size & 1))
+        q->mid = q->mid->next;
+}
+
+/* Follow node, about to be removed from q, before size is decremented */
+static inline void finger_remove(queue_t *q, struct list_head *node)
+{
+    if (!q->mid)
+        return;
+    if (q->size == 1)
+        q->mid = NULL;
+    else if (node == q->mid)
+        q->mid = (q->size & 1) ? node->next : node->prev;
+    else if (node == q->head.next && (q->size & 1))
+        q->mid = q->mid->next;
+    else if (node == q->head.prev && !(q->size & 1))
+        q->mid = q->mid->prev;
+}
+
+#define finger_reset(q) ((q)->mid = NULL)
+#else
+#define finger_add(q, at_head) ((void) 0)
+#define finger_remove(q, node) ((void) 0)
+#define finger_reset(q) ((void) 0)
+#endif
+
+#ifdef QUEUE_LAZY_REVERSE
+#define queue_reversed(q) ((q)->reversed)
+#else
+#define queue_reversed(q) false
+#endif
+
+/* Get the node after node in queue order, or before if reversed */
+static inline struct list_head *q_step(const struct list_head *node,
+                                       bool reversed)
+{
+    return reversed ? node->prev : node->next;
+}
+
+/* Reverse a list by swapping the links of every node */
+static void list_reverse(struct list_head *head)
+{
+    struct list_head *node = head;
+    do {
+        struct list_head *next = node->next;
+        node->next = node->prev;
+        node->prev = next;
+        node = next;
+    } while (node != head);
+}
+
+/* Reverse the list of q, keeping the middle finger on the middle */
+static void queue_flip(queue_t *q)
+{
+    list_reverse(&q->head);
+#ifdef QUEUE_MIDDLE_FINGER
+    /* Index size / 2 turns into size - 1 - size / 2, one node short of the
+     * middle for an even size, which the old prev, now next, fixes
+     */
+    if (q->mid && !(q->size & 1))
+        q->mid = q->mid->next;
+#endif
+}
+
+/* Relink the list of q in queue order if q_reverse() left it reversed */
+static inline void queue_unreverse(queue_t *q)
+{
+#ifdef QUEUE_LAZY_REVERSE
+    if (q->reversed) {
+        queue_flip(q);
+        q->reversed = false;
+    }
+#else
+    (void) q;
+#endif
+}
+
+/* Stop using the express lanes of queue q, once it may not be sorted any
+ * longer. Most callers run with allocation, and freeing, disallowed: the lanes
+ * are freed by the next q_insert_sorted(), or by q_free().
+ */
+static inline void skip_drop(queue_t *q)
+{
+    q->skip_stale = true;
+}
+
+/* Get the express lanes of queue q, or NULL if they are stale or missing */
+static inline skiplist_t *skip_lanes(queue_t *q)
+{
+    return q->skip_stale ? NULL : q->skip;
+}
 
 /* Create an empty queue */
 struct list_head *q_new()
 {
-    return NULL;
+    queue_t *q = malloc(sizeof(queue_t));
+    if (!q)
+        return NULL;
+
+    if (!element_store_init(&q->store)) {
+        free(q);
+        return NULL;
+    }
+    INIT_LIST_HEAD(&q->head);
+    q->size = 0;
+    q->skip = NULL;
+    q->skip_stale = false;
+    finger_reset(q);
+#ifdef QUEUE_LAZY_REVERSE
+    q->reversed = false;
+#endif
+    return &q->head;
 }
 
 /* Free all storage used by queue */
-void q_free(struct list_head *l) {}
+void q_free(struct list_head *l)
+{
+    if (!l)
+        return;
+
+    queue_t *q = to_queue(l);
+    skip_free(q->skip);
+#ifndef QUEUE_USE_ARENA
+    element_t *e, *safe;
+    list_for_each_entry_safe (e, safe, l, list)
+        q_release_element(e);
+#endif
+    /* With QUEUE_USE_ARENA, the elements go with the store as a whole */
+    element_store_free(&q->store);
+    free(q);
+}
+
+
+/* Insert an element at head (at_head) or tail of queue */
+static bool queue_insert(struct list_head *head, char *s, bool at_head)
+{
+    if (!head || !s)
+        return false;
+
+    queue_t *q = to_queue(head);
+    element_t *e = element_new(&q->store, s);
+    if (!e)
+        return false;
+
+    /* The head of a reversed queue is the tail of its list */
+    at_head ^= queue_reversed(q);
+    if (at_head)
+        list_add(&e->list, head);
+    else
+        list_add_tail(&e->list, head);
+    q->size++;
+    finger_add(q, at_head);
+    skip_drop(q);
+    return true;
+}
 
 /* Insert an element at head of queue */
 bool q_insert_head(struct list_head *head, char *s)
 {
-    return true;
+    return queue_insert(head, s, true);
 }
 
 /* Insert an element at tail of queue */
 bool q_insert_tail(struct list_head *head, char *s)
 {
-    return true;
+    return queue_insert(head, s, false);
+}
+
+/* Insert elements at head (at_head) or tail of queue, building them into a
+ * list of their own in queue order, then splicing it in
+ */
+static int queue_insert_bulk(struct list_head *head,
+                             char **s,
+                             int n,
+                             bool at_head)
+{
+    if (!head || !s)
+        return 0;
+
+    queue_t *q = to_queue(head);
+    LIST_HEAD(chain);
+    int done = 0;
+    for (int i = 0; i < n; i++) {
+        element_t *e = s[i] ? element_new(&q->store, s[i]) : NULL;
+        if (!e)
+            continue;
+        if (at_head)
+            list_add(&e->list, &chain);
+        else
+            list_add_tail(&e->list, &chain);
+        done++;
+    }
+    if (!done)
+        return 0;
+
+    /* The list of a reversed queue runs from its tail */
+    if (queue_reversed(q)) {
+        list_reverse(&chain);
+        at_head = !at_head;
+    }
+    if (at_head)
+        list_splice(&chain, head);
+    else
+        list_splice_tail(&chain, head);
+    q->size += done;
+    /* The middle moves by done / 2 nodes, let q_delete_mid() find it */
+    finger_reset(q);
+    skip_drop(q);
+    return done;
+}
+
+/* Insert elements at head of queue */
+int q_insert_head_bulk(struct list_head *head, char **s, int n)
+{
+    return queue_insert_bulk(head, s, n, true);
+}
+
+/* Insert elements at tail of queue */
+int q_insert_tail_bulk(struct list_head *head, char **s, int n)
+{
+    return queue_insert_bulk(head, s, n, false);
+}
+
+/* Unlink node from queue head and copy its string to sp (up to bufsize - 1
+ * characters)
+ */
+static element_t *remove_node(struct list_head *head,
+                              struct list_head *node,
+                              char *sp,
+                              size_t bufsize)
+{
+    queue_t *q = to_queue(head);
+    element_t *e = list_entry(node, element_t, list);
+    finger_remove(q, node);
+    if (skip_lanes(q))
+        skip_remove(q->skip, e);
+    list_del(node);
+    q->size--;
+
+    if (sp && bufsize) {
+        strncpy(sp, e->value, bufsize - 1);
+        sp[bufsize - 1] = '\0';
+    }
+    return e;
 }
 
 /* Remove an element from head of queue */
 element_t *q_remove_head(struct list_head *head, char *sp, size_t bufsize)
 {
-    return NULL;
+    if (!head || list_empty(head))
+        return NULL;
+
+    return remove_node(head, q_step(head, queue_reversed(to_queue(head))), sp,
+                       bufsize);
 }
 
 /* Remove an element from tail of queue */
 element_t *q_remove_tail(struct list_head *head, char *sp, size_t bufsize)
 {
-    return NULL;
+    if (!head || list_empty(head))
+        return NULL;
+
+    return remove_node(head, q_step(head, !queue_reversed(to_queue(head))),
+                       sp, bufsize);
+}
+
+/* Remove n elements from head (at_head) or tail of queue into list, cutting
+ * them off with one list_cut_position()
+ */
+static int queue_remove_n(struct list_head *head,
+                          int n,
+                          struct list_head *list,
+                          char *sp,
+                          size_t bufsize,
+                          bool at_head)
+{
+    if (!list)
+        return 0;
+    INIT_LIST_HEAD(list);
+    if (!head || list_empty(head) || n <= 0)
+        return 0;
+
+    queue_t *q = to_queue(head);
+    if (n > q->size)
+        n = q->size;
+
+    /* The head of a reversed queue is the tail of its list. Find the last
+     * node of the front part of the list, from whichever end is closer.
+     */
+    bool front = at_head ^ queue_reversed(q);
+    int k = front ? n : q->size - n;
+    struct list_head *cut = head;
+    if (k <= q->size / 2) {
+        for (int i = 0; i < k; i++)
+            cut = cut->next;
+    } else {
+        for (int i = k; i <= q->size; i++)
+            cut = cut->prev;
+    }
+
+    if (front) {
+        list_cut_position(list, head, cut);
+    } else {
+        LIST_HEAD(kept);
+        list_cut_position(&kept, head, cut);
+        list_splice_tail_init(head, list);
+        list_splice_init(&kept, head);
+    }
+    if (queue_reversed(q))
+        list_reverse(list);
+    q->size -= n;
+    finger_reset(q);
+    skip_drop(q);
+
+    pack_strings(list, sp, bufsize);
+    return n;
+}
+
+/* Remove elements from head of queue */
+int q_remove_head_n(struct list_head *head,
+                    int n,
+                    struct list_head *list,
+                    char *sp,
+                    size_t bufsize)
+{
+    return queue_remove_n(head, n, list, sp, bufsize, true);
+}
+
+/* Remove elements from tail of queue */
+int q_remove_tail_n(struct list_head *head,
+                    int n,
+                    struct list_head *list,
+                    char *sp,
+                    size_t bufsize)
+{
+    return queue_remove_n(head, n, list, sp, bufsize, false);
+}
+
+/* Start a walk of queue at its head */
+element_t *q_first(struct list_head *head, q_iter_t *it)
+{
+    it->head = head;
+    if (!head || list_empty(head)) {
+        it->node = head;
+        return NULL;
+    }
+    it->reversed = queue_reversed(to_queue(head));
+    it->node = q_step(head, it->reversed);
+    return list_entry(it->node, element_t, list);
+}
+
+/* Step to the next element of a walk */
+element_t *q_next(q_iter_t *it)
+{
+    if (it->node == it->head)
+        return NULL;
+    it->node = q_step(it->node, it->reversed);
+    return it->node == it->head ? NULL
+                                : list_entry(it->node, element_t, list);
+}
+
+/* Get the element at tail of queue */
+element_t *q_last(struct list_head *head)
+{
+    if (!head || list_empty(head))
+        return NULL;
+    return list_entry(q_step(head, !queue_reversed(to_queue(head))),
+                      element_t, list);
 }
 
 /* Return number of elements in queue */
 int q_size(struct list_head *head)
 {
-    return -1;
+    if (!head)
+        return 0;
+
+    queue_t *q = to_queue(head);
+    if (size_check) {
+        int len = 0;
+        struct list_head *node;
+        list_for_each (node, head)
+            len++;
+        if (len != q->size)
+            report_event(MSG_ERROR,
+                         "Cached queue size is %d, but the queue holds %d "
+                         "elements",
+                         q->size, len);
+    }
+    return q->size;
 }
 
 /* Delete the middle node in queue */
 bool q_delete_mid(struct list_head *head)
 {
     // https://leetcode.com/problems/delete-the-middle-node-of-a-linked-list/
+    if (!head || list_empty(head))
+        return false;
+
+    queue_t *q = to_queue(head);
+    struct list_head *mid;
+#ifdef QUEUE_MIDDLE_FINGER
+    if (!q->mid) {
+        q->mid = head->next;
+        for (int i = q->size / 2; i; i--)
+            q->mid = q->mid->next;
+    }
+    mid = q->mid;
+    /* Index size / 2 of a reversed queue is one node before for an even size */
+    if (queue_reversed(q) && !(q->size & 1))
+        mid = mid->prev;
+    finger_remove(q, mid);
+#else
+    /* Walk from both ends until the cursors meet */
+    struct list_head *fwd = head->next, *bwd = head->prev;
+    while (fwd != bwd && fwd->next != bwd) {
+        fwd = fwd->next;
+        bwd = bwd->prev;
+    }
+    /* They meet at index size / 2 of the list, from either end */
+    mid = queue_reversed(q) ? fwd : bwd;
+#endif
+
+    if (skip_lanes(q))
+        skip_remove(q->skip, list_entry(mid, element_t, list));
+    list_del(mid);
+    q_release_element(list_entry(mid, element_t, list));
+    q->size--;
+    return true;
+}
+
+/* Delete all elements whose string is found more than once in queue q */
+static bool queue_delete_dup_hash(queue_t *q)
+{
+    dup_table_t t;
+    if (!dup_table_init(&t, q->size))
+        return false;
+
+    element_t *e, *safe;
+    list_for_each_entry (e, &q->head, list)
+        dup_table_add(&t, e);
+    list_for_each_entry_safe (e, safe, &q->head, list) {
+        if (dup_table_next(&t)) {
+            list_del(&e->list);
+            q_release_element(e);
+            q->size--;
+        }
+    }
+    dup_table_free(&t);
+    finger_reset(q);
     return true;
 }
 
@@ -61,6 +529,35 @@ bool q_delete_mid(struct list_head *head)
 bool q_delete_dup(struct list_head *head)
 {
     // https://leetcode.com/problems/remove-duplicates-from-sorted-list-ii/
+    if (!head)
+        return false;
+
+    queue_t *q = to_queue(head);
+    skip_drop(q);
+    if (dedup_hash)
+        return queue_delete_dup_hash(q);
+    struct list_head *node = head->next;
+    finger_reset(q);
+    while (node != head) {
+        struct list_head *next = node->next;
+        if (next == head || element_cmp(NULL, node, next)) {
+            node = next;
+            continue;
+        }
+
+        /* Drop the whole run of equal strings starting at node */
+        while (next != head && !element_cmp(NULL, node, next)) {
+            struct list_head *tmp = next->next;
+            list_del(next);
+            q_release_element(list_entry(next, element_t, list));
+            q->size--;
+            next = tmp;
+        }
+        list_del(node);
+        q_release_element(list_entry(node, element_t, list));
+        q->size--;
+        node = next;
+    }
     return true;
 }
 
@@ -68,31 +565,263 @@ bool q_delete_dup(struct list_head *head)
 void q_swap(struct list_head *head)
 {
     // https://leetcode.com/problems/swap-nodes-in-pairs/
+    q_reverseK(head, 2);
 }
 
 /* Reverse elements in queue */
-void q_reverse(struct list_head *head) {}
+void q_reverse(struct list_head *head)
+{
+    if (!head)
+        return;
+
+    skip_drop(to_queue(head));
+#ifdef QUEUE_LAZY_REVERSE
+    to_queue(head)->reversed ^= true;
+#else
+    queue_flip(to_queue(head));
+#endif
+}
 
 /* Reverse the nodes of the list k at a time */
 void q_reverseK(struct list_head *head, int k)
 {
     // https://leetcode.com/problems/reverse-nodes-in-k-group/
+    if (!head || k < 2)
+        return;
+
+    queue_unreverse(to_queue(head));
+    finger_reset(to_queue(head));
+    skip_drop(to_queue(head));
+    LIST_HEAD(done);
+    for (;;) {
+        struct list_head *tail = head;
+        int n = 0;
+        while (n < k && tail->next != head) {
+            tail = tail->next;
+            n++;
+        }
+        if (n < k)
+            break;
+
+        LIST_HEAD(group);
+        list_cut_position(&group, head, tail);
+        list_reverse(&group);
+        list_splice_tail(&group, &done);
+    }
+    list_splice(&done, head);
 }
 
 /* Sort elements of queue in ascending order */
-void q_sort(struct list_head *head) {}
+void q_sort(struct list_head *head)
+{
+    sort_compares = 0;
+    if (!head || list_empty(head) || list_is_singular(head))
+        return;
+
+    /* Order is about to be lost anyway, no need to relink */
+#ifdef QUEUE_LAZY_REVERSE
+    to_queue(head)->reversed = false;
+#endif
+    finger_reset(to_queue(head));
+    skip_drop(to_queue(head));
+    sort_elements(head, to_queue(head)->size);
+}
+
+/* Sort queue in ascending order and delete all nodes that have duplicate
+ * string */
+int q_sort_unique(struct list_head *head)
+{
+    sort_compares = 0;
+    if (!head)
+        return 0;
+
+    queue_t *q = to_queue(head);
+#ifdef QUEUE_LAZY_REVERSE
+    q->reversed = false;
+#endif
+    finger_reset(q);
+    skip_drop(q);
+    q->size = sort_unique_elements(head, q->size);
+    return q->size;
+}
+
+/* Find the k-th smallest element of queue, partitioning it around that */
+element_t *q_select(struct list_head *head, int k)
+{
+    sort_compares = 0;
+    if (!head || k < 0 || k >= to_queue(head)->size)
+        return NULL;
+
+    queue_t *q = to_queue(head);
+#ifdef QUEUE_LAZY_REVERSE
+    q->reversed = false;
+#endif
+    finger_reset(q);
+    skip_drop(q);
+    return select_elements(head, q->size, k);
+}
+
+/* Return the express lanes over sorted queue q, or NULL. Stale ones are freed
+ * and, like missing ones, built again if skip_index is set: only call this
+ * where allocation is allowed. The lanes run over the list, in queue order.
+ */
+static skiplist_t *queue_skip(queue_t *q)
+{
+    queue_unreverse(q);
+    if (q->skip_stale) {
+        skip_free(q->skip);
+        q->skip = NULL;
+        q->skip_stale = false;
+    }
+    if (!q->skip && skip_index)
+        q->skip = skip_new(&q->head);
+    return q->skip;
+}
+
+/* Find the first node of sorted queue q whose string is not below s, or above
+ * it if after is set. The lanes are used if they are up to date, but never
+ * built, so that searches allocate nothing.
+ */
+static struct list_head *queue_search(queue_t *q, const char *s, bool after)
+{
+    queue_unreverse(q);
+    skiplist_t *skip = skip_lanes(q);
+    if (skip)
+        return skip_search(skip, s, after);
+    return search_elements(&q->head, s, after);
+}
+
+/* Insert an element into sorted queue, after the ones up to its string */
+bool q_insert_sorted(struct list_head *head, char *s)
+{
+    if (!head || !s)
+        return false;
+
+    queue_t *q = to_queue(head);
+    element_t *e = element_new(&q->store, s);
+    if (!e)
+        return false;
+
+    skiplist_t *skip = queue_skip(q);
+    if (skip)
+        skip_insert(skip, e);
+    else
+        list_add_tail(&e->list, search_elements(head, s, true));
+    q->size++;
+    finger_reset(q);
+    return true;
+}
+
+/* Find the first element of sorted queue with string s */
+element_t *q_find(struct list_head *head, const char *s)
+{
+    if (!head || !s)
+        return NULL;
+
+    struct list_head *node = queue_search(to_queue(head), s, false);
+    if (node == head)
+        return NULL;
+    element_t *e = list_entry(node, element_t, list);
+    return strcmp(e->value, s) ? NULL : e;
+}
+
+/* Remove the first element of sorted queue with string s */
+element_t *q_remove_value(struct list_head *head, const char *s)
+{
+    element_t *e = q_find(head, s);
+    if (!e)
+        return NULL;
+    /* remove_node() moves the middle along for the ends of the queue only */
+    finger_reset(to_queue(head));
+    return remove_node(head, &e->list, NULL, 0);
+}
 
 /* Remove every node which has a node with a strictly greater value anywhere to
  * the right side of it */
 int q_descend(struct list_head *head)
 {
     // https://leetcode.com/problems/remove-nodes-from-linked-list/
-    return 0;
+    if (!head || list_empty(head))
+        return 0;
+
+    queue_unreverse(to_queue(head));
+    finger_reset(to_queue(head));
+    skip_drop(to_queue(head));
+
+    /* Walk backwards, keeping the largest value seen so far */
+    int len = 1;
+    struct list_head *max = head->prev, *node = max->prev;
+    while (node != head) {
+        struct list_head *prev = node->prev;
+        if (element_cmp(NULL, node, max) < 0) {
+            list_del(node);
+            q_release_element(list_entry(node, element_t, list));
+        } else {
+            max = node;
+            len++;
+        }
+        node = prev;
+    }
+    to_queue(head)->size = len;
+    return len;
 }
 
 /* Merge all the queues into one sorted queue, which is in ascending order */
 int q_merge(struct list_head *head)
 {
     // https://leetcode.com/problems/merge-k-sorted-lists/
-    return 0;
+    if (!head || list_empty(head))
+        return 0;
+
+    queue_contex_t *first = list_first_entry(head, queue_contex_t, chain);
+    if (!first->q)
+        return 0;
+
+    /* Merge the queues pairwise, the one step places after each into it, with
+     * step doubling every round. Each element then takes part in log2(k)
+     * merges, and no room is needed beyond the chain itself.
+     */
+    for (int step = 1;; step *= 2) {
+        queue_contex_t *ctx = first;
+        bool merged = false;
+
+        for (;;) {
+            struct list_head *pos = &ctx->chain;
+            for (int i = 0; i < step && pos != head; i++)
+                pos = pos->next;
+            if (pos == head)
+                break;
+
+            queue_contex_t *other = list_entry(pos, queue_contex_t, chain);
+            merged = true;
+            if (ctx->q && other->q) {
+                queue_unreverse(to_queue(ctx->q));
+                queue_unreverse(to_queue(other->q));
+                merge_elements(NULL, ctx->q, other->q);
+                to_queue(ctx->q)->size += to_queue(other->q)->size;
+                to_queue(other->q)->size = 0;
+                finger_reset(to_queue(ctx->q));
+                finger_reset(to_queue(other->q));
+                skip_drop(to_queue(ctx->q));
+                skip_drop(to_queue(other->q));
+                other->size = 0;
+#ifdef QUEUE_USE_ARENA
+                /* The elements now belong to ctx, and so does storage */
+                arena_steal(&to_queue(ctx->q)->store.arena,
+                            &to_queue(other->q)->store.arena);
+#endif
+            }
+
+            for (int i = 0; i < step && pos != head; i++)
+                pos = pos->next;
+            if (pos == head)
+                break;
+            ctx = list_entry(pos, queue_contex_t, chain);
+        }
+        if (!merged)
+            break;
+    }
+
+    first->size = q_size(first->q);
+    return first->size;
 }
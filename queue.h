@@ -4,25 +4,63 @@
 /* This program implements a queue supporting both FIFO and LIFO
  * operations.
  *
- * It uses a circular doubly-linked list to represent the set of queue elements
+ * It uses a circular doubly-linked list to represent the set of queue elements,
+ * or arrays of them with the backends of queue_chunk.c and queue_ring.c.
  */
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <string.h>
 
 #include "harness.h"
 #include "list.h"
 
+/* Storage of elements and strings comes from the slab allocator in pool.c
+ * when QUEUE_USE_POOL is defined, from the arena of the owning queue when
+ * QUEUE_USE_ARENA is defined, or from test_malloc otherwise.
+ */
+#ifdef QUEUE_USE_POOL
+#include "pool.h"
+#define q_alloc_block(size) pool_alloc(size)
+#define q_free_block(p, size) pool_free(p, size)
+#define q_block_fits(size, fit) pool_fits(size, fit)
+#elif defined(QUEUE_USE_ARENA)
+#include "arena.h"
+/* Arena blocks are reclaimed all at once by q_free */
+#define q_free_block(p, size) ((void) test_free_permitted())
+#define q_block_fits(size, fit) ((fit) <= (size))
+#else
+#define q_alloc_block(size) test_malloc(size)
+#define q_free_block(p, size) test_free(p)
+#define q_block_fits(size, fit) ((fit) <= (size))
+#endif
+
 /**
  * element_t - Linked list element
  * @value: pointer to array holding string
  * @list: node of a doubly-linked list
+ * @key: first 8 bytes of the string, big-endian (QUEUE_KEY_PREFIX only)
+ * @data: inline storage of the string (QUEUE_INLINE_STRING only)
  *
- * @value needs to be explicitly allocated and freed
+ * @value needs to be explicitly allocated and freed, unless QUEUE_INLINE_STRING
+ * is defined. In that case the string is stored in @data right after @list,
+ * @value points to @data, and the element is allocated as a single block.
+ *
+ * With QUEUE_KEY_PREFIX, @key holds the bytes of the string up to its NUL,
+ * at most 8 of them, the first one in the most significant byte and zeros
+ * after the end. Comparing keys as integers thus orders elements like strcmp
+ * does on those bytes, without following @value.
  */
 typedef struct {
     char *value;
     struct list_head list;
+#ifdef QUEUE_KEY_PREFIX
+    uint64_t key;
+#endif
+#ifdef QUEUE_INLINE_STRING
+    char data[];
+#endif
 } element_t;
 
 /**
@@ -39,6 +77,47 @@ typedef struct {
     int id;
 } queue_contex_t;
 
+/* Tunables of the queue implementation, set by the 'option' command of qtest */
+
+/* Algorithms q_sort() can use, selected by sort_algo */
+enum {
+    SORT_LIST_SORT, /* bottom-up merge sort of list_sort.c (default) */
+    SORT_TOP_DOWN,  /* recursive top-down merge sort */
+    SORT_ADAPTIVE,  /* natural merge sort of list_sort.c, for presorted data */
+    SORT_RADIX,     /* MSD radix sort on the bytes of the strings */
+};
+extern int sort_algo;
+
+/* Number of threads q_sort() runs on. With more than one, the queue is cut
+ * into one segment per thread, the segments are sorted concurrently with
+ * sort_algo, then merged pairwise in parallel.
+ */
+extern int sort_threads;
+
+/* Have q_size() check its cached count against a walk of the list, and report
+ * an error if they differ
+ */
+extern int size_check;
+
+/* Number of comparisons made by the last q_sort() */
+extern size_t sort_compares;
+
+/* Have q_delete_dup() delete every string found more than once anywhere in
+ * the queue, counted in a hash table, rather than adjacent duplicates only
+ */
+extern int dedup_hash;
+
+/* Number of released elements each queue keeps for reuse by its inserts, see
+ * q_recycle_element(). The default of 0 disables the cache.
+ */
+extern int recycle_limit;
+
+/* Have q_insert_sorted(), q_find() and q_remove_value() keep a skip list over
+ * a queue, which they search in O(log n) rather than walking it (list backend
+ * only)
+ */
+extern int skip_index;
+
 /* Operations on queue */
 
 /**
@@ -78,6 +157,34 @@ bool q_insert_head(struct list_head *head, char *s);
  */
 bool q_insert_tail(struct list_head *head, char *s);
 
+/**
+ * q_insert_head_bulk() - Insert elements in the head
+ * @head: header of queue
+ * @s: array of strings would be inserted
+ * @n: number of strings in @s
+ *
+ * Same as calling q_insert_head() on s[0] to s[n - 1] in turn, so that
+ * s[n - 1] ends up at the head, but the new elements are linked together first
+ * and attached to the queue at once. A string whose element cannot be
+ * allocated is skipped.
+ *
+ * Return: the number of elements inserted, 0 if queue is NULL
+ */
+int q_insert_head_bulk(struct list_head *head, char **s, int n);
+
+/**
+ * q_insert_tail_bulk() - Insert elements at the tail
+ * @head: header of queue
+ * @s: array of strings would be inserted
+ * @n: number of strings in @s
+ *
+ * Same as calling q_insert_tail() on s[0] to s[n - 1] in turn, so that s[n - 1]
+ * ends up at the tail. See q_insert_head_bulk().
+ *
+ * Return: the number of elements inserted, 0 if queue is NULL
+ */
+int q_insert_tail_bulk(struct list_head *head, char **s, int n);
+
 /**
  * q_remove_head() - Remove the element from head of queue
  * @head: header of queue
@@ -108,6 +215,48 @@ element_t *q_remove_head(struct list_head *head, char *sp, size_t bufsize);
  */
 element_t *q_remove_tail(struct list_head *head, char *sp, size_t bufsize);
 
+/**
+ * q_remove_head_n() - Remove elements from head of queue
+ * @head: header of queue
+ * @n: number of elements would be removed
+ * @list: header of a list, initialized here, receiving the elements removed
+ * @sp: buffer receiving copies of their strings, or NULL
+ * @bufsize: size of the buffer
+ *
+ * Detach the first n elements of the queue, or all of them if there are fewer,
+ * into @list. They keep their order there, linked through their list member.
+ *
+ * If sp is non-NULL, their strings are copied to it one after another, each
+ * with its null terminator, as far as bufsize bytes go. The last one copied
+ * may be cut short, and still ends with a null terminator.
+ *
+ * Return: the number of elements removed, 0 if queue is NULL or empty.
+ */
+int q_remove_head_n(struct list_head *head,
+                    int n,
+                    struct list_head *list,
+                    char *sp,
+                    size_t bufsize);
+
+/**
+ * q_remove_tail_n() - Remove elements from tail of queue
+ * @head: header of queue
+ * @n: number of elements would be removed
+ * @list: header of a list, initialized here, receiving the elements removed
+ * @sp: buffer receiving copies of their strings, or NULL
+ * @bufsize: size of the buffer
+ *
+ * Same as q_remove_head_n() on the last n elements, which also keep their
+ * order in @list: the tail of the queue ends up at the tail of @list.
+ *
+ * Return: the number of elements removed, 0 if queue is NULL or empty.
+ */
+int q_remove_tail_n(struct list_head *head,
+                    int n,
+                    struct list_head *list,
+                    char *sp,
+                    size_t bufsize);
+
 /**
  * q_release_element() - Release the element
  * @e: element would be released
@@ -116,14 +265,87 @@ element_t *q_remove_tail(struct list_head *head, char *sp, size_t bufsize);
  */
 static inline void q_release_element(element_t *e)
 {
-    test_free(e->value);
-    test_free(e);
+#ifdef QUEUE_INLINE_STRING
+    q_free_block(e, sizeof(element_t) + strlen(e->value) + 1);
+#else
+    q_free_block(e->value, strlen(e->value) + 1);
+    q_free_block(e, sizeof(element_t));
+#endif
 }
 
+/**
+ * q_recycle_element() - Release an element removed from a queue, for reuse
+ * @head: header of the queue the element was removed from
+ * @e: element would be released
+ *
+ * The element, with its string, goes to a cache of the queue holding up to
+ * recycle_limit of them, or is released if the cache is full. Inserts into the
+ * queue take elements from the cache before allocating, and keep the string
+ * storage too if the new string fits in it.
+ */
+void q_recycle_element(struct list_head *head, element_t *e);
+
+/**
+ * q_recycle_flush() - Release the elements kept for reuse by a queue
+ * @head: header of queue
+ *
+ * q_free() does it too.
+ */
+void q_recycle_flush(struct list_head *head);
+
+/**
+ * q_iter_t - Position in a queue, for walking it from head to tail
+ * @head: header of the queue
+ * @node: list node of the current element, or of the chunk holding it
+ * @slot: index of the current element in its chunk or ring (array backends)
+ * @reversed: the list of the queue runs backwards (list backend only)
+ *
+ * Elements are laid out differently by each backend of the queue: linked
+ * through their list member by queue.c, held in arrays chained into a list by
+ * queue_chunk.c, or in a ring buffer by queue_ring.c. Code outside of the
+ * queue walks it with q_first() and q_next() instead of following the list of
+ * @head, and leaves the fields to the backend.
+ */
+typedef struct {
+    struct list_head *head;
+    struct list_head *node;
+    int slot;
+    bool reversed;
+} q_iter_t;
+
+/**
+ * q_first() - Start a walk of the queue at its head
+ * @head: header of queue
+ * @it: iterator to set up
+ *
+ * The queue must not be changed while the walk goes on.
+ *
+ * Return: the first element, NULL if queue is NULL or empty
+ */
+element_t *q_first(struct list_head *head, q_iter_t *it);
+
+/**
+ * q_next() - Step to the next element of a walk started by q_first()
+ * @it: iterator
+ *
+ * Return: the element after the current one, NULL past the tail
+ */
+element_t *q_next(q_iter_t *it);
+
+/**
+ * q_last() - Get the element at the tail of the queue
+ * @head: header of queue
+ *
+ * Return: the last element, NULL if queue is NULL or empty
+ */
+element_t *q_last(struct list_head *head);
+
 /**
  * q_size() - Get the size of the queue
  * @head: header of queue
  *
+ * The size is cached in the header of the queue, so this takes constant time.
+ *
  * Return: the number of elements in queue, zero if queue is NULL or empty
  */
 int q_size(struct list_head *head);
@@ -151,7 +373,11 @@ bool q_delete_mid(struct list_head *head);
  * Reference:
  * https://leetcode.com/problems/remove-duplicates-from-sorted-list-ii/
  *
- * Return: true for success, false if list is NULL.
+ * Duplicates must be adjacent, as in a sorted queue, unless dedup_hash is set.
+ * The queue is then left in its order, less every element whose string it
+ * holds more than once, in O(n) expected time and one table allocated.
+ *
+ * Return: true for success, false if list is NULL or allocation failed.
  */
 bool q_delete_dup(struct list_head *head);
 
@@ -172,6 +398,8 @@ void q_swap(struct list_head *head);
  * This function should not allocate or free any list elements
  * (e.g., by calling q_insert_head, q_insert_tail, or q_remove_head).
  * It should rearrange the existing ones.
+ * With QUEUE_LAZY_REVERSE, it flips the direction of the queue in constant
+ * time instead, and the list of the queue runs backwards, see q_iter_t.
  */
 void q_reverse(struct list_head *head);
 
@@ -199,6 +427,69 @@ void q_reverseK(struct list_head *head, int k);
  */
 void q_sort(struct list_head *head);
 
+/**
+ * q_sort_unique() - Sort queue in ascending order and delete all nodes that
+ * have duplicate string, as q_sort() then q_delete_dup() would
+ * @head: header of queue
+ *
+ * The duplicates are released while the sort links the queue together for the
+ * last time, which walks it once for both.
+ *
+ * Return: number of elements left, or 0 if queue is NULL.
+ */
+int q_sort_unique(struct list_head *head);
+
+/**
+ * q_select() - Find the k-th smallest element of queue, without sorting it
+ * @head: header of queue
+ * @k: index of the element in the queue once sorted, from 0
+ *
+ * The queue is partitioned in place, in expected linear time: afterwards,
+ * smaller strings come first, then the ones equal to that of the element
+ * found, then greater ones. The median is at k == q_size(head) / 2.
+ *
+ * Return: the element found, still in queue, or NULL if queue is NULL or @k
+ * is out of range.
+ */
+element_t *q_select(struct list_head *head, int k);
+
+/**
+ * q_insert_sorted() - Insert an element into a sorted queue, keeping it sorted
+ * @head: header of queue
+ * @s: string would be inserted
+ *
+ * The element goes after the ones with strings up to @s. With skip_index set,
+ * the list backend finds that place through express lanes kept over the queue
+ * until an operation which may break its order, in O(log n) expected time.
+ * Otherwise the queue is walked from its head.
+ *
+ * Return: true for success, false if allocation failed or queue is NULL.
+ */
+bool q_insert_sorted(struct list_head *head, char *s);
+
+/**
+ * q_find() - Find an element of a sorted queue by its string
+ * @head: header of queue
+ * @s: string sought
+ *
+ * The queue is searched as q_insert_sorted() does.
+ *
+ * Return: the first element whose string equals @s, or NULL if there is none
+ * or queue is NULL.
+ */
+element_t *q_find(struct list_head *head, const char *s);
+
+/**
+ * q_remove_value() - Remove an element of a sorted queue by its string
+ * @head: header of queue
+ * @s: string of the element would be removed
+ *
+ * The element found by q_find() is unlinked, and not released.
+ *
+ * Return: the element removed, or NULL if there is none or queue is NULL.
+ */
+element_t *q_remove_value(struct list_head *head, const char *s);
+
 /**
  * q_descend() - Remove every node which has a node with a strictly greater
  * value anywhere to the right side of it.
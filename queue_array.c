@@ -0,0 +1,214 @@
+/* Operations shared by the array backends of the queue, written against
+ * the functions of queue_array.h
+ */
+
+#include <string.h>
+
+#include "queue_array.h"
+#include "queue_element.h"
+#include "queue_sort.h"
+
+/* Insert elements at head of queue. Slots take them as they come, there is no
+ * linking to save.
+ */
+int q_insert_head_bulk(struct list_head *head, char **s, int n)
+{
+    int done = 0;
+    for (int i = 0; head && s && i < n; i++)
+        done += q_insert_head(head, s[i]);
+    return done;
+}
+
+/* Insert elements at tail of queue */
+int q_insert_tail_bulk(struct list_head *head, char **s, int n)
+{
+    int done = 0;
+    for (int i = 0; head && s && i < n; i++)
+        done += q_insert_tail(head, s[i]);
+    return done;
+}
+
+/* Remove elements from head of queue. They are linked one by one, having no
+ * list to cut from.
+ */
+int q_remove_head_n(struct list_head *head,
+                    int n,
+                    struct list_head *list,
+                    char *sp,
+                    size_t bufsize)
+{
+    if (!list)
+        return 0;
+    INIT_LIST_HEAD(list);
+
+    int done = 0;
+    element_t *e;
+    while (done < n && (e = q_remove_head(head, NULL, 0))) {
+        list_add_tail(&e->list, list);
+        done++;
+    }
+    pack_strings(list, sp, bufsize);
+    return done;
+}
+
+/* Remove elements from tail of queue */
+int q_remove_tail_n(struct list_head *head,
+                    int n,
+                    struct list_head *list,
+                    char *sp,
+                    size_t bufsize)
+{
+    if (!list)
+        return 0;
+    INIT_LIST_HEAD(list);
+
+    int done = 0;
+    element_t *e;
+    while (done < n && (e = q_remove_tail(head, NULL, 0))) {
+        list_add(&e->list, list);
+        done++;
+    }
+    pack_strings(list, sp, bufsize);
+    return done;
+}
+
+/* Swap every two adjacent nodes */
+void q_swap(struct list_head *head)
+{
+    // https://leetcode.com/problems/swap-nodes-in-pairs/
+    q_reverseK(head, 2);
+}
+
+/* Sort elements of queue in ascending order */
+void q_sort(struct list_head *head)
+{
+    sort_compares = 0;
+    if (!head || q_size(head) < 2)
+        return;
+
+    LIST_HEAD(list);
+    int n = queue_unpack(head, &list);
+    sort_elements(&list, n);
+    queue_pack(head, &list);
+}
+
+/* Sort queue in ascending order and delete all nodes that have duplicate
+ * string */
+int q_sort_unique(struct list_head *head)
+{
+    sort_compares = 0;
+    if (!head)
+        return 0;
+
+    LIST_HEAD(list);
+    int n = queue_unpack(head, &list);
+    n = sort_unique_elements(&list, n);
+    queue_pack(head, &list);
+    return n;
+}
+
+/* Find the k-th smallest element of queue, partitioning it around that */
+element_t *q_select(struct list_head *head, int k)
+{
+    sort_compares = 0;
+    if (!head || k < 0 || k >= q_size(head))
+        return NULL;
+
+    LIST_HEAD(list);
+    int n = queue_unpack(head, &list);
+    element_t *e = select_elements(&list, n, k);
+    queue_pack(head, &list);
+    return e;
+}
+
+/* Insert an element into sorted queue, after the ones up to its string */
+bool q_insert_sorted(struct list_head *head, char *s)
+{
+    if (!head || !s)
+        return false;
+
+    q_iter_t it;
+    queue_search(head, s, true, &it);
+    return queue_insert_at(&it, s);
+}
+
+/* Find the first element of sorted queue with string s */
+element_t *q_find(struct list_head *head, const char *s)
+{
+    if (!head || !s)
+        return NULL;
+
+    q_iter_t it;
+    element_t *e = queue_search(head, s, false, &it);
+    return e && !strcmp(e->value, s) ? e : NULL;
+}
+
+/* Remove the first element of sorted queue with string s */
+element_t *q_remove_value(struct list_head *head, const char *s)
+{
+    if (!head || !s)
+        return NULL;
+
+    q_iter_t it;
+    element_t *e = queue_search(head, s, false, &it);
+    if (!e || strcmp(e->value, s))
+        return NULL;
+    return queue_remove_at(&it);
+}
+
+/* Merge all the queues into one sorted queue, which is in ascending order */
+int q_merge(struct list_head *head)
+{
+    // https://leetcode.com/problems/merge-k-sorted-lists/
+    if (!head || list_empty(head))
+        return 0;
+
+    queue_contex_t *first = list_first_entry(head, queue_contex_t, chain);
+    if (!first->q)
+        return 0;
+
+    /* Merge the queues pairwise as queue.c does. Each merge unpacks both
+     * queues, and packs the result into the first one, with the slots of both.
+     */
+    for (int step = 1;; step *= 2) {
+        queue_contex_t *ctx = first;
+        bool merged = false;
+
+        for (;;) {
+            struct list_head *pos = &ctx->chain;
+            for (int i = 0; i < step && pos != head; i++)
+                pos = pos->next;
+            if (pos == head)
+                break;
+
+            queue_contex_t *other = list_entry(pos, queue_contex_t, chain);
+            merged = true;
+            if (ctx->q && other->q) {
+                LIST_HEAD(list);
+                LIST_HEAD(list_other);
+                queue_unpack(ctx->q, &list);
+                queue_unpack(other->q, &list_other);
+                merge_elements(NULL, &list, &list_other);
+                queue_hand_over(ctx->q, other->q);
+                queue_pack(ctx->q, &list);
+                other->size = 0;
+#ifdef QUEUE_USE_ARENA
+                /* The elements now belong to ctx, and so does storage */
+                arena_steal(&queue_store(ctx->q)->arena,
+                            &queue_store(other->q)->arena);
+#endif
+            }
+
+            for (int i = 0; i < step && pos != head; i++)
+                pos = pos->next;
+            if (pos == head)
+                break;
+            ctx = list_entry(pos, queue_contex_t, chain);
+        }
+        if (!merged)
+            break;
+    }
+
+    first->size = q_size(first->q);
+    return first->size;
+}
@@ -0,0 +1,83 @@
+#ifndef LAB0_QUEUE_ARRAY_H
+#define LAB0_QUEUE_ARRAY_H
+
+/* Operations shared by the array backends of the queue, queue_chunk.c and
+ * queue_ring.c, which hold pointers to the elements in slots rather than
+ * linking them. The ones which reorder the queue unpack it into a plain list,
+ * run the algorithms of queue_sort.c on it, and pack it back. The sorted ones
+ * search the slots and shift them in place. Each backend defines the
+ * functions below for them.
+ */
+
+#include <stdbool.h>
+
+#include "queue.h"
+
+/**
+ * queue_unpack() - Link the elements of a queue into a list
+ * @head: header of the queue
+ * @list: empty list, which receives the elements in queue order
+ *
+ * The elements are linked through their list member. The queue must not be
+ * used again before queue_pack().
+ *
+ * Return: the number of elements linked.
+ */
+int queue_unpack(struct list_head *head, struct list_head *list);
+
+/**
+ * queue_pack() - Put the elements of a list back into a queue
+ * @head: header of the queue, unpacked
+ * @list: elements, in queue order, left empty
+ *
+ * Nothing is allocated, as long as @list holds no more elements than were
+ * unpacked from the queue, plus those of queues handed over by
+ * queue_hand_over().
+ */
+void queue_pack(struct list_head *head, struct list_head *list);
+
+/**
+ * queue_hand_over() - Give the slots of a queue to another one
+ * @to: header of the queue, unpacked, which receives the slots
+ * @from: header of the queue, unpacked, left empty
+ *
+ * Used by q_merge(), so that packing the elements of both queues into @to
+ * allocates nothing.
+ */
+void queue_hand_over(struct list_head *to, struct list_head *from);
+
+/**
+ * queue_search() - Find where a string goes in a sorted queue
+ * @head: header of the queue
+ * @s: string sought
+ * @after: skip the elements whose string equals @s too
+ * @it: iterator, placed on the element found, or past the last one
+ *
+ * Return: the first element whose string is not below @s (above it if @after
+ * is set), or NULL if there is none.
+ */
+element_t *queue_search(struct list_head *head,
+                        const char *s,
+                        bool after,
+                        q_iter_t *it);
+
+/**
+ * queue_insert_at() - Insert an element before the position of an iterator
+ * @it: iterator on an element, or past the last one to insert at tail
+ * @s: string to copy into the element
+ *
+ * The elements are shifted in place, without unpacking the queue.
+ *
+ * Return: true on success, false if allocation fails.
+ */
+bool queue_insert_at(q_iter_t *it, char *s);
+
+/**
+ * queue_remove_at() - Remove the element at the position of an iterator
+ * @it: iterator on an element, which must not be used afterwards
+ *
+ * Return: the element removed.
+ */
+element_t *queue_remove_at(q_iter_t *it);
+
+#endif /* LAB0_QUEUE_ARRAY_H */
@@ -0,0 +1,713 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "queue.h"
+#include "queue_array.h"
+#include "queue_element.h"
+#include "queue_hash.h"
+#include "queue_sort.h"
+#include "report.h"
+
+/* Unrolled backend of the queue: instead of linking every element, the queue
+ * links chunks, each an array of pointers to up to CHUNK_SLOTS elements. A
+ * walk of the queue then follows one pointer per chunk rather than one per
+ * element, and pushing or popping at either end mostly writes a slot.
+ *
+ * The list member of elements is not used to hold the queue together. Sorting
+ * and merging borrow it to run the algorithms of queue_sort.c on a plain list,
+ * then pack the elements back into chunks.
+ */
+
+#define CHUNK_SLOTS 32
+
+/**
+ * chunk_t - Array of consecutive elements of a queue
+ * @list: node in the list of chunks of the queue
+ * @begin: index of the first slot in use
+ * @end: index past the last slot in use
+ * @slot: elements, in queue order, from @begin to @end
+ *
+ * A chunk added at the head of the queue fills from its end, and one added at
+ * the tail fills from its start, so that a run of inserts at one end goes on
+ * in the same chunk. Chunks in the queue are never empty.
+ */
+typedef struct {
+    struct list_head list;
+    int begin, end;
+    element_t *slot[CHUNK_SLOTS];
+} chunk_t;
+
+/* Have q_size() check the cached size against a count of the chunks */
+int size_check = 0;
+
+/* Sorted operations walk the queue here, there are no express lanes */
+int skip_index = 0;
+
+/**
+ * queue_t - Header of a queue
+ * @head: list head of the chunks, handed out by q_new(), must stay first
+ * @size: number of elements, kept up to date by every operation
+ * @spare: chunks out of use, kept to save an allocation, freed by q_free()
+ * @store: storage of the elements, and those released for reuse
+ *
+ * Operations running with allocation disallowed, such as q_sort() and
+ * q_merge(), leave the chunks they no longer need in @spare. Otherwise at most
+ * one chunk is kept there.
+ */
+typedef struct {
+    struct list_head head;
+    int size;
+    struct list_head spare;
+    element_store_t store;
+} queue_t;
+
+static inline queue_t *to_queue(struct list_head *head)
+{
+    return container_of(head, queue_t, head);
+}
+
+element_store_t *queue_store(struct list_head *head)
+{
+    return &to_queue(head)->store;
+}
+
+static inline chunk_t *to_chunk(struct list_head *node)
+{
+    return list_entry(node, chunk_t, list);
+}
+
+/* Get a chunk for q, a spare one if any, with its slots in use from index at */
+static chunk_t *chunk_get(queue_t *q, int at)
+{
+    chunk_t *c;
+    if (!list_empty(&q->spare)) {
+        c = list_first_entry(&q->spare, chunk_t, list);
+        list_del(&c->list);
+    } else {
+        c = malloc(sizeof(chunk_t));
+        if (!c)
+            return NULL;
+    }
+    c->begin = c->end = at;
+    return c;
+}
+
+/* Take chunk c, just emptied, out of queue q */
+static void chunk_put(queue_t *q, chunk_t *c)
+{
+    if (list_empty(&q->spare)) {
+        list_move(&c->list, &q->spare);
+    } else {
+        list_del(&c->list);
+        free(c);
+    }
+}
+
+/* Element at the position of iterator it, which must be on an element */
+static inline element_t **iter_slot(const q_iter_t *it)
+{
+    return &to_chunk(it->node)->slot[it->slot];
+}
+
+/* Move it to the previous element, or to the header before the first one */
+static void iter_prev(q_iter_t *it)
+{
+    if (it->node != it->head && it->slot > to_chunk(it->node)->begin) {
+        it->slot--;
+        return;
+    }
+    it->node = it->node->prev;
+    if (it->node != it->head)
+        it->slot = to_chunk(it->node)->end - 1;
+}
+
+/* Set it on the last element of queue head, or on head if it is empty */
+static void iter_last(struct list_head *head, q_iter_t *it)
+{
+    it->head = head;
+    it->node = head;
+    iter_prev(it);
+}
+
+/* Drop the elements from it onwards out of queue q, keeping the ones before */
+static void queue_cut_tail(queue_t *q, q_iter_t *it)
+{
+    while (it->node != &q->head) {
+        chunk_t *c = to_chunk(it->node);
+        it->node = it->node->next;
+        if (it->slot > c->begin) {
+            c->end = it->slot;
+        } else {
+            chunk_put(q, c);
+        }
+        if (it->node != &q->head)
+            it->slot = to_chunk(it->node)->begin;
+    }
+}
+
+/* Drop the elements up to it out of queue q, keeping the ones after */
+static void queue_cut_head(queue_t *q, q_iter_t *it)
+{
+    while (it->node != &q->head) {
+        chunk_t *c = to_chunk(it->node);
+        it->node = it->node->prev;
+        if (it->slot < c->end - 1) {
+            c->begin = it->slot + 1;
+        } else {
+            chunk_put(q, c);
+        }
+        if (it->node != &q->head)
+            it->slot = to_chunk(it->node)->end - 1;
+    }
+}
+
+/* Link every element of q into list, in queue order, through their list
+ * member. The chunks keep pointing to them until queue_pack().
+ */
+int queue_unpack(struct list_head *head, struct list_head *list)
+{
+    queue_t *q = to_queue(head);
+    chunk_t *c;
+    list_for_each_entry (c, &q->head, list) {
+        for (int i = c->begin; i < c->end; i++)
+            list_add_tail(&c->slot[i]->list, list);
+    }
+    return q->size;
+}
+
+/* Fill the chunks of q, spare ones included, with the elements of list in
+ * order. Nothing is allocated: q holds enough chunks as long as list has no
+ * more elements than q had when unpacked, plus those of queues whose chunks
+ * moved to the spares of q.
+ */
+void queue_pack(struct list_head *head, struct list_head *list)
+{
+    queue_t *q = to_queue(head);
+    chunk_t *c = NULL;
+    element_t *e;
+
+    list_splice_init(&q->head, &q->spare);
+    q->size = 0;
+    list_for_each_entry (e, list, list) {
+        if (!c || c->end == CHUNK_SLOTS) {
+            c = list_first_entry(&q->spare, chunk_t, list);
+            list_move_tail(&c->list, &q->head);
+            c->begin = c->end = 0;
+        }
+        c->slot[c->end++] = e;
+        q->size++;
+    }
+}
+
+/* Move the chunks of from, in use or spare, to the spares of to */
+void queue_hand_over(struct list_head *to, struct list_head *from)
+{
+    queue_t *t = to_queue(to), *f = to_queue(from);
+    list_splice_init(&f->head, &t->spare);
+    list_splice_init(&f->spare, &t->spare);
+    f->size = 0;
+}
+
+/* Create an empty queue */
+struct list_head *q_new()
+{
+    queue_t *q = malloc(sizeof(queue_t));
+    if (!q)
+        return NULL;
+
+    /* Start with a spare chunk, so that the first insert does not allocate
+     * one and costs the same as the next ones
+     */
+    chunk_t *c = malloc(sizeof(chunk_t));
+    if (!c) {
+        free(q);
+        return NULL;
+    }
+    if (!element_store_init(&q->store)) {
+        free(c);
+        free(q);
+        return NULL;
+    }
+    INIT_LIST_HEAD(&q->head);
+    INIT_LIST_HEAD(&q->spare);
+    list_add(&c->list, &q->spare);
+    q->size = 0;
+    return &q->head;
+}
+
+/* Free all storage used by queue */
+void q_free(struct list_head *l)
+{
+    if (!l)
+        return;
+
+    queue_t *q = to_queue(l);
+    chunk_t *c, *safe;
+#ifndef QUEUE_USE_ARENA
+    list_for_each_entry (c, l, list) {
+        for (int i = c->begin; i < c->end; i++)
+            q_release_element(c->slot[i]);
+    }
+#endif
+    list_splice_init(l, &q->spare);
+    list_for_each_entry_safe (c, safe, &q->spare, list)
+        free(c);
+    /* With QUEUE_USE_ARENA, the elements go with the store as a whole */
+    element_store_free(&q->store);
+    free(q);
+}
+
+/* Insert an element at head of queue */
+bool q_insert_head(struct list_head *head, char *s)
+{
+    if (!head || !s)
+        return false;
+
+    queue_t *q = to_queue(head);
+    chunk_t *c = list_empty(head) ? NULL : to_chunk(head->next);
+    if (!c || c->begin == 0) {
+        c = chunk_get(q, CHUNK_SLOTS);
+        if (!c)
+            return false;
+        list_add(&c->list, head);
+    }
+
+    element_t *e = element_new(&q->store, s);
+    if (!e) {
+        if (c->begin == c->end)
+            chunk_put(q, c);
+        return false;
+    }
+    c->slot[--c->begin] = e;
+    q->size++;
+    return true;
+}
+
+/* Insert an element at tail of queue */
+bool q_insert_tail(struct list_head *head, char *s)
+{
+    if (!head || !s)
+        return false;
+
+    queue_t *q = to_queue(head);
+    chunk_t *c = list_empty(head) ? NULL : to_chunk(head->prev);
+    if (!c || c->end == CHUNK_SLOTS) {
+        c = chunk_get(q, 0);
+        if (!c)
+            return false;
+        list_add_tail(&c->list, head);
+    }
+
+    element_t *e = element_new(&q->store, s);
+    if (!e) {
+        if (c->begin == c->end)
+            chunk_put(q, c);
+        return false;
+    }
+    c->slot[c->end++] = e;
+    q->size++;
+    return true;
+}
+
+/* Copy the string of removed element e of queue head to sp (up to bufsize - 1
+ * characters)
+ */
+static element_t *removed(struct list_head *head,
+                          element_t *e,
+                          char *sp,
+                          size_t bufsize)
+{
+    to_queue(head)->size--;
+    if (sp && bufsize) {
+        strncpy(sp, e->value, bufsize - 1);
+        sp[bufsize - 1] = '\0';
+    }
+    return e;
+}
+
+/* Remove an element from head of queue */
+element_t *q_remove_head(struct list_head *head, char *sp, size_t bufsize)
+{
+    if (!head || list_empty(head))
+        return NULL;
+
+    chunk_t *c = to_chunk(head->next);
+    element_t *e = c->slot[c->begin++];
+    if (c->begin == c->end)
+        chunk_put(to_queue(head), c);
+    return removed(head, e, sp, bufsize);
+}
+
+/* Remove an element from tail of queue */
+element_t *q_remove_tail(struct list_head *head, char *sp, size_t bufsize)
+{
+    if (!head || list_empty(head))
+        return NULL;
+
+    chunk_t *c = to_chunk(head->prev);
+    element_t *e = c->slot[--c->end];
+    if (c->begin == c->end)
+        chunk_put(to_queue(head), c);
+    return removed(head, e, sp, bufsize);
+}
+
+/* Start a walk of queue at its head */
+element_t *q_first(struct list_head *head, q_iter_t *it)
+{
+    it->head = it->node = head;
+    if (!head || list_empty(head))
+        return NULL;
+    it->node = head->next;
+    it->slot = to_chunk(it->node)->begin;
+    return *iter_slot(it);
+}
+
+/* Step to the next element of a walk */
+element_t *q_next(q_iter_t *it)
+{
+    if (it->node == it->head)
+        return NULL;
+    if (++it->slot == to_chunk(it->node)->end) {
+        it->node = it->node->next;
+        if (it->node == it->head)
+            return NULL;
+        it->slot = to_chunk(it->node)->begin;
+    }
+    return *iter_slot(it);
+}
+
+/* Get the element at tail of queue */
+element_t *q_last(struct list_head *head)
+{
+    if (!head || list_empty(head))
+        return NULL;
+    chunk_t *c = to_chunk(head->prev);
+    return c->slot[c->end - 1];
+}
+
+/* Return number of elements in queue */
+int q_size(struct list_head *head)
+{
+    if (!head)
+        return 0;
+
+    queue_t *q = to_queue(head);
+    if (size_check) {
+        int len = 0;
+        chunk_t *c;
+        list_for_each_entry (c, head, list)
+            len += c->end - c->begin;
+        if (len != q->size)
+            report_event(MSG_ERROR,
+                         "Cached queue size is %d, but the queue holds %d "
+                         "elements",
+                         q->size, len);
+    }
+    return q->size;
+}
+
+/* Take the element in slot i of chunk c out of queue q, closing the gap from
+ * the shorter side of the chunk
+ */
+static element_t *chunk_take(queue_t *q, chunk_t *c, int i)
+{
+    element_t *e = c->slot[i];
+    if (i - c->begin < c->end - 1 - i) {
+        memmove(&c->slot[c->begin + 1], &c->slot[c->begin],
+                (i - c->begin) * sizeof(element_t *));
+        c->begin++;
+    } else {
+        memmove(&c->slot[i], &c->slot[i + 1],
+                (c->end - 1 - i) * sizeof(element_t *));
+        c->end--;
+    }
+    if (c->begin == c->end)
+        chunk_put(q, c);
+    q->size--;
+    return e;
+}
+
+/* Delete the middle node in queue */
+bool q_delete_mid(struct list_head *head)
+{
+    // https://leetcode.com/problems/delete-the-middle-node-of-a-linked-list/
+    if (!head || list_empty(head))
+        return false;
+
+    /* Skip whole chunks up to the one holding index size / 2 */
+    queue_t *q = to_queue(head);
+    int i = q->size / 2;
+    chunk_t *c = to_chunk(head->next);
+    while (i >= c->end - c->begin) {
+        i -= c->end - c->begin;
+        c = to_chunk(c->list.next);
+    }
+
+    q_release_element(chunk_take(q, c, c->begin + i));
+    return true;
+}
+
+/* Delete all elements whose string is found more than once in queue q,
+ * copying the others down as q_delete_dup() does
+ */
+static bool queue_delete_dup_hash(queue_t *q)
+{
+    dup_table_t t;
+    if (!dup_table_init(&t, q->size))
+        return false;
+
+    q_iter_t r, w;
+    for (element_t *e = q_first(&q->head, &r); e; e = q_next(&r))
+        dup_table_add(&t, e);
+    element_t *e = q_first(&q->head, &r);
+    q_first(&q->head, &w);
+    int len = 0;
+    while (e) {
+        element_t *next = q_next(&r);
+        if (dup_table_next(&t)) {
+            q_release_element(e);
+        } else {
+            *iter_slot(&w) = e;
+            q_next(&w);
+            len++;
+        }
+        e = next;
+    }
+    queue_cut_tail(q, &w);
+    q->size = len;
+    dup_table_free(&t);
+    return true;
+}
+
+/* Delete all nodes that have duplicate string */
+bool q_delete_dup(struct list_head *head)
+{
+    // https://leetcode.com/problems/remove-duplicates-from-sorted-list-ii/
+    if (!head)
+        return false;
+
+    /* Copy the elements kept from the read position to the write one, which
+     * never gets ahead of it, then cut what is left behind the latter
+     */
+    queue_t *q = to_queue(head);
+    if (dedup_hash)
+        return queue_delete_dup_hash(q);
+    q_iter_t r, w;
+    element_t *e = q_first(head, &r);
+    q_first(head, &w);
+    int len = 0;
+    bool dup = false;
+    while (e) {
+        element_t *next = q_next(&r);
+        if (next && !strcmp(e->value, next->value)) {
+            q_release_element(e);
+            dup = true;
+        } else if (dup) {
+            q_release_element(e);
+            dup = false;
+        } else {
+            *iter_slot(&w) = e;
+            q_next(&w);
+            len++;
+        }
+        e = next;
+    }
+    queue_cut_tail(q, &w);
+    q->size = len;
+    return true;
+}
+
+/* Reverse the slots in use of chunk c, and mirror them in the chunk so that
+ * the side with room stays toward the same end of the queue
+ */
+static void chunk_reverse(chunk_t *c)
+{
+    for (int i = c->begin, j = c->end - 1; i < j; i++, j--) {
+        element_t *tmp = c->slot[i];
+        c->slot[i] = c->slot[j];
+        c->slot[j] = tmp;
+    }
+    int begin = CHUNK_SLOTS - c->end;
+    memmove(&c->slot[begin], &c->slot[c->begin],
+            (c->end - c->begin) * sizeof(element_t *));
+    c->end = CHUNK_SLOTS - c->begin;
+    c->begin = begin;
+}
+
+/* Reverse elements in queue */
+void q_reverse(struct list_head *head)
+{
+    if (!head)
+        return;
+
+    /* Swap the links of every chunk, then reverse each of them */
+    struct list_head *node = head;
+    do {
+        struct list_head *next = node->next;
+        node->next = node->prev;
+        node->prev = next;
+        if (node != head)
+            chunk_reverse(to_chunk(node));
+        node = next;
+    } while (node != head);
+}
+
+/* Reverse the nodes of the list k at a time */
+void q_reverseK(struct list_head *head, int k)
+{
+    // https://leetcode.com/problems/reverse-nodes-in-k-group/
+    if (!head || k < 2)
+        return;
+
+    /* Swap the elements of each group from both of its ends inward */
+    int left = to_queue(head)->size;
+    q_iter_t start;
+    q_first(head, &start);
+    for (; left >= k; left -= k) {
+        q_iter_t lo = start, hi = start;
+        for (int i = 1; i < k; i++)
+            q_next(&hi);
+        start = hi;
+        q_next(&start);
+        for (int i = 0; i < k / 2; i++) {
+            element_t *tmp = *iter_slot(&lo);
+            *iter_slot(&lo) = *iter_slot(&hi);
+            *iter_slot(&hi) = tmp;
+            q_next(&lo);
+            iter_prev(&hi);
+        }
+    }
+}
+
+/* Tell whether string s goes before the element in slot i of chunk c, or
+ * after it too if after is set
+ */
+static inline bool goes_before(const chunk_t *c,
+                               int i,
+                               const char *s,
+                               bool after)
+{
+    int cmp = strcmp(c->slot[i]->value, s);
+    return cmp > 0 || (!after && !cmp);
+}
+
+/* Skip the chunks whose last string is below s, then bisect the slots of the
+ * next one
+ */
+element_t *queue_search(struct list_head *head,
+                        const char *s,
+                        bool after,
+                        q_iter_t *it)
+{
+    it->head = it->node = head;
+    chunk_t *c;
+    list_for_each_entry (c, head, list) {
+        if (goes_before(c, c->end - 1, s, after))
+            break;
+    }
+    if (&c->list == head)
+        return NULL;
+
+    int lo = c->begin, hi = c->end - 1;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (goes_before(c, mid, s, after))
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    it->node = &c->list;
+    it->slot = lo;
+    return c->slot[lo];
+}
+
+/* Insert a copy of s before the slot of it, shifting the shorter side of its
+ * chunk. A full chunk is split in two halves first.
+ */
+bool queue_insert_at(q_iter_t *it, char *s)
+{
+    if (it->node == it->head)
+        return q_insert_tail(it->head, s);
+
+    queue_t *q = to_queue(it->head);
+    chunk_t *c = to_chunk(it->node), *split = NULL;
+    int at = it->slot;
+    if (c->end - c->begin == CHUNK_SLOTS) {
+        split = chunk_get(q, 0);
+        if (!split)
+            return false;
+        list_add(&split->list, &c->list);
+    }
+
+    element_t *e = element_new(&q->store, s);
+    if (!e) {
+        if (split)
+            chunk_put(q, split);
+        return false;
+    }
+    if (split) {
+        memcpy(split->slot, &c->slot[CHUNK_SLOTS / 2],
+               CHUNK_SLOTS / 2 * sizeof(element_t *));
+        split->end = c->end = CHUNK_SLOTS / 2;
+        if (at >= CHUNK_SLOTS / 2) {
+            c = split;
+            at -= CHUNK_SLOTS / 2;
+        }
+    }
+
+    if (c->begin && (at - c->begin <= c->end - at || c->end == CHUNK_SLOTS)) {
+        memmove(&c->slot[c->begin - 1], &c->slot[c->begin],
+                (at - c->begin) * sizeof(element_t *));
+        c->begin--;
+        c->slot[at - 1] = e;
+    } else {
+        memmove(&c->slot[at + 1], &c->slot[at],
+                (c->end - at) * sizeof(element_t *));
+        c->end++;
+        c->slot[at] = e;
+    }
+    q->size++;
+    return true;
+}
+
+element_t *queue_remove_at(q_iter_t *it)
+{
+    return chunk_take(to_queue(it->head), to_chunk(it->node), it->slot);
+}
+
+/* Remove every node which has a node with a strictly greater value anywhere to
+ * the right side of it */
+int q_descend(struct list_head *head)
+{
+    // https://leetcode.com/problems/remove-nodes-from-linked-list/
+    if (!head || list_empty(head))
+        return 0;
+
+    /* Walk backwards, keeping the largest value seen so far, and copy the
+     * elements kept toward the tail as in q_delete_dup()
+     */
+    queue_t *q = to_queue(head);
+    q_iter_t r, w;
+    iter_last(head, &r);
+    iter_last(head, &w);
+    element_t *max = *iter_slot(&r);
+    int len = 1;
+    iter_prev(&r);
+    iter_prev(&w);
+    while (r.node != head) {
+        element_t *e = *iter_slot(&r);
+        if (strcmp(e->value, max->value) < 0) {
+            q_release_element(e);
+        } else {
+            max = e;
+            *iter_slot(&w) = e;
+            iter_prev(&w);
+            len++;
+        }
+        iter_prev(&r);
+    }
+    queue_cut_head(q, &w);
+    q->size = len;
+    return len;
+}
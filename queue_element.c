@@ -0,0 +1,147 @@
+/* Allocation and reuse of queue elements, shared by the backends of the queue
+ */
+
+#include <string.h>
+
+#include "queue_element.h"
+#include "queue_sort.h"
+
+/* Number of released elements each queue keeps for reuse */
+int recycle_limit = 0;
+
+/* Allocate a block for an element or a string of store st */
+static inline void *store_alloc(element_store_t *st, size_t size)
+{
+#ifdef QUEUE_USE_ARENA
+    return arena_alloc(&st->arena, size);
+#else
+    (void) st;
+    return q_alloc_block(size);
+#endif
+}
+
+/* Allocate an element of store st with room for a string of len bytes.
+ * With QUEUE_INLINE_STRING, the string lives in the same block as the element.
+ */
+static element_t *element_alloc(element_store_t *st, size_t len)
+{
+#ifdef QUEUE_INLINE_STRING
+    element_t *e = store_alloc(st, sizeof(element_t) + len);
+    if (!e)
+        return NULL;
+    e->value = e->data;
+#else
+    element_t *e = store_alloc(st, sizeof(element_t));
+    if (!e)
+        return NULL;
+    e->value = store_alloc(st, len);
+    if (!e->value) {
+        q_free_block(e, sizeof(element_t));
+        return NULL;
+    }
+#endif
+    return e;
+}
+
+/* Take an element released to store st out of its cache, with room for a
+ * string of len bytes. Its old string tells the room it has.
+ */
+static element_t *element_reuse(element_store_t *st, size_t len)
+{
+    if (list_empty(&st->cache))
+        return NULL;
+
+    element_t *e = list_first_entry(&st->cache, element_t, list);
+    size_t room = strlen(e->value) + 1;
+    list_del(&e->list);
+    st->nr_cached--;
+#ifdef QUEUE_INLINE_STRING
+    if (!q_block_fits(sizeof(element_t) + room, sizeof(element_t) + len)) {
+        q_release_element(e);
+        return NULL;
+    }
+#else
+    if (!q_block_fits(room, len)) {
+        char *value = store_alloc(st, len);
+        if (!value) {
+            q_release_element(e);
+            return NULL;
+        }
+        q_free_block(e->value, room);
+        e->value = value;
+    }
+#endif
+    return e;
+}
+
+/* Release the elements kept for reuse by store st */
+static void store_flush(element_store_t *st)
+{
+    element_t *e, *safe;
+    list_for_each_entry_safe (e, safe, &st->cache, list)
+        q_release_element(e);
+    INIT_LIST_HEAD(&st->cache);
+    st->nr_cached = 0;
+}
+
+element_t *element_new(element_store_t *st, const char *s)
+{
+    size_t len = strlen(s) + 1;
+    element_t *e = element_reuse(st, len);
+    if (!e)
+        e = element_alloc(st, len);
+    if (!e)
+        return NULL;
+    memcpy(e->value, s, len);
+#ifdef QUEUE_KEY_PREFIX
+    e->key = key_prefix(s);
+#endif
+    return e;
+}
+
+bool element_store_init(element_store_t *st)
+{
+#ifdef QUEUE_USE_ARENA
+    if (!arena_init(&st->arena))
+        return false;
+#endif
+    INIT_LIST_HEAD(&st->cache);
+    st->nr_cached = 0;
+    return true;
+}
+
+void element_store_free(element_store_t *st)
+{
+    store_flush(st);
+#ifdef QUEUE_USE_ARENA
+    arena_release(&st->arena);
+#endif
+#ifdef QUEUE_USE_POOL
+    /* Hand the slabs back once the last element is gone */
+    pool_release();
+#endif
+}
+
+/* Release an element removed from queue, keeping it for reuse */
+void q_recycle_element(struct list_head *head, element_t *e)
+{
+    if (!e)
+        return;
+
+    element_store_t *st = head ? queue_store(head) : NULL;
+    if (!st || st->nr_cached >= recycle_limit) {
+        q_release_element(e);
+        return;
+    }
+    list_add(&e->list, &st->cache);
+    st->nr_cached++;
+}
+
+/* Release the elements kept for reuse by queue */
+void q_recycle_flush(struct list_head *head)
+{
+    if (!head)
+        return;
+
+    store_flush(queue_store(head));
+}
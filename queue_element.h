@@ -0,0 +1,58 @@
+#ifndef LAB0_QUEUE_ELEMENT_H
+#define LAB0_QUEUE_ELEMENT_H
+
+/* Allocation and reuse of queue elements, shared by the backends of the
+ * queue. Each backend embeds an element_store_t in its header, and hands it
+ * out through queue_store().
+ */
+
+#include <stdbool.h>
+
+#include "queue.h"
+
+/**
+ * element_store_t - Storage of the elements of a queue
+ * @cache: released elements kept for reuse, see q_recycle_element()
+ * @nr_cached: number of elements in @cache
+ * @arena: storage of the elements and their strings (QUEUE_USE_ARENA only)
+ */
+typedef struct {
+    struct list_head cache;
+    int nr_cached;
+#ifdef QUEUE_USE_ARENA
+    arena_t arena;
+#endif
+} element_store_t;
+
+/**
+ * queue_store() - Get the element storage of a queue
+ * @head: header of the queue
+ *
+ * Defined by the backend, which knows where its queue_t keeps the store.
+ *
+ * Return: the store of the queue.
+ */
+element_store_t *queue_store(struct list_head *head);
+
+/* Initialize an empty store. Return false if allocation fails. */
+bool element_store_init(element_store_t *st);
+
+/* Release the store of a queue, along with its cached elements. With
+ * QUEUE_USE_ARENA, this releases every element allocated from it too, so
+ * the queue must not release them one by one.
+ */
+void element_store_free(element_store_t *st);
+
+/**
+ * element_new() - Allocate an element holding a copy of a string
+ * @st: store of the queue the element goes into
+ * @s: string to copy
+ *
+ * An element released to @st by q_recycle_element() is reused if its blocks
+ * have room for @s.
+ *
+ * Return: the element, or NULL if allocation fails.
+ */
+element_t *element_new(element_store_t *st, const char *s);
+
+#endif /* LAB0_QUEUE_ELEMENT_H */
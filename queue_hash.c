@@ -0,0 +1,66 @@
+/* Hash table of the strings of queue elements, shared by the backends of the
+ * queue
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "queue_hash.h"
+
+/* Have q_delete_dup() delete duplicates anywhere in the queue */
+int dedup_hash = 0;
+
+/* 64-bit FNV-1a hash of string s */
+static inline uint64_t hash_string(const char *s)
+{
+    uint64_t h = 0xcbf29ce484222325;
+    for (; *s; s++)
+        h = (h ^ (unsigned char) *s) * 0x100000001b3;
+    return h;
+}
+
+bool dup_table_init(dup_table_t *t, int n)
+{
+    size_t nr_slots = 16;
+    while (nr_slots < 2 * (size_t) n)
+        nr_slots <<= 1;
+
+    /* The slots, then the index of the slot of each element */
+    size_t size = nr_slots * sizeof(dup_slot_t) + n * sizeof(uint32_t);
+    t->slots = malloc(size);
+    if (!t->slots)
+        return false;
+    memset(t->slots, 0, nr_slots * sizeof(dup_slot_t));
+    t->mask = nr_slots - 1;
+    t->at = (uint32_t *) (t->slots + nr_slots);
+    t->nr_added = t->nr_read = 0;
+    return true;
+}
+
+void dup_table_add(dup_table_t *t, const element_t *e)
+{
+    uint64_t h = hash_string(e->value);
+    size_t i = (h >> 32) & t->mask;
+    dup_slot_t *slot;
+
+    /* Probe linearly for the string, or the first free slot */
+    for (;; i = (i + 1) & t->mask) {
+        slot = &t->slots[i];
+        if (!slot->value) {
+            slot->value = e->value;
+            slot->hash = (uint32_t) h;
+            break;
+        }
+        if (slot->hash == (uint32_t) h && !strcmp(slot->value, e->value))
+            break;
+    }
+    slot->count++;
+    t->at[t->nr_added++] = i;
+}
+
+void dup_table_free(dup_table_t *t)
+{
+    free(t->slots);
+    t->slots = NULL;
+    t->at = NULL;
+}
@@ -0,0 +1,62 @@
+#ifndef LAB0_QUEUE_HASH_H
+#define LAB0_QUEUE_HASH_H
+
+/* Hashing of the strings of queue elements, shared by the backends of the
+ * queue, so that q_delete_dup() needs no sorted queue.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "queue.h"
+
+/**
+ * dup_slot_t - Slot of a dup_table_t
+ * @value: string, or NULL if the slot is free
+ * @hash: low 32 bits of the hash of @value
+ * @count: number of elements added with @value
+ */
+typedef struct {
+    const char *value;
+    uint32_t hash;
+    int count;
+} dup_slot_t;
+
+/**
+ * dup_table_t - Count of each string of a queue, by open addressing
+ * @slots: mask + 1 slots, at least twice as many as elements
+ * @mask: number of slots minus one
+ * @at: index in @slots of the string of each element added, in order
+ * @nr_added: number of elements added
+ * @nr_read: number of elements read back by dup_table_next()
+ *
+ * The elements are added once, then read back in the same order through @at,
+ * which never looks at their strings again: the ones found to be duplicates
+ * can be released on the way.
+ */
+typedef struct {
+    dup_slot_t *slots;
+    size_t mask;
+    uint32_t *at;
+    int nr_added, nr_read;
+} dup_table_t;
+
+/* Allocate the table for up to n elements, in one block. Return false if
+ * allocation fails.
+ */
+bool dup_table_init(dup_table_t *t, int n);
+
+/* Add the string of element e */
+void dup_table_add(dup_table_t *t, const element_t *e);
+
+/* Tell whether the string of the next element added, in order, was added more
+ * than once
+ */
+static inline bool dup_table_next(dup_table_t *t)
+{
+    return t->slots[t->at[t->nr_read++]].count > 1;
+}
+
+void dup_table_free(dup_table_t *t);
+
+#endif /* LAB0_QUEUE_HASH_H */
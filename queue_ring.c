@@ -0,0 +1,728 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "queue.h"
+#include "queue_array.h"
+#include "queue_element.h"
+#include "queue_hash.h"
+#include "queue_sort.h"
+#include "report.h"
+
+/* Ring buffer backend of the queue: the elements are pointed to by a
+ * power-of-two array of slots used as a ring, indexed by unsigned counters
+ * which wrap around and are masked into the array. Pushing or popping at
+ * either end writes a slot and moves a counter.
+ *
+ * A full ring grows into one twice as large, without copying it at once: the
+ * slots of the old ring are moved RING_STEP at a time by the inserts and
+ * removes which follow, and are read from it in the meantime. Each operation
+ * thus stays constant time.
+ *
+ * q_merge() cannot allocate a larger ring. What does not fit in the one it
+ * keeps is spilled to a list, linked through the list member of the elements,
+ * which follows the ring. Growing the ring drains that list back into it.
+ */
+
+#define RING_MIN_SLOTS 16
+#define RING_STEP 2
+
+/* Have q_size() check the cached size against a count of the elements */
+int size_check = 0;
+
+/* Sorted operations walk the queue here, there are no express lanes */
+int skip_index = 0;
+
+/**
+ * queue_t - Header of a queue
+ * @head: list head handed out by q_new(), must stay first, links nothing
+ * @size: number of elements, in the ring and spilled
+ * @ring: slots of the ring, mask + 1 of them
+ * @mask: number of slots of @ring minus one
+ * @first: index of the first element of the ring
+ * @count: number of elements in the ring, from @first on
+ * @old: slots of the ring before it last grew, NULL once released
+ * @old_mask: number of slots of @old minus one
+ * @from: index of the first element not moved yet from @old to @ring
+ * @to: index past the last element not moved yet from @old to @ring
+ * @spill: elements past the last one of the ring, in order
+ * @store: storage of the elements, and those released for reuse
+ *
+ * The element at index i, from @from to @to, is still in slot i & @old_mask of
+ * @old. Any other one is in slot i & @mask of @ring.
+ */
+typedef struct {
+    struct list_head head;
+    int size;
+    element_t **ring;
+    unsigned mask;
+    unsigned first;
+    int count;
+    element_t **old;
+    unsigned old_mask;
+    unsigned from, to;
+    struct list_head spill;
+    element_store_t store;
+} queue_t;
+
+static inline queue_t *to_queue(struct list_head *head)
+{
+    return container_of(head, queue_t, head);
+}
+
+element_store_t *queue_store(struct list_head *head)
+{
+    return &to_queue(head)->store;
+}
+
+/* Slot of the element at position i of the ring of q */
+static inline element_t **ring_at(queue_t *q, int i)
+{
+    unsigned at = q->first + i;
+    if (at - q->from < q->to - q->from)
+        return &q->old[at & q->old_mask];
+    return &q->ring[at & q->mask];
+}
+
+/* Keep the range of elements left in the old ring within the ring of q, once
+ * elements are removed at either end
+ */
+static void ring_clip(queue_t *q)
+{
+    unsigned end = q->first + q->count;
+    if ((int) (q->from - q->first) < 0)
+        q->from = q->first;
+    if ((int) (q->to - end) > 0)
+        q->to = end;
+    if ((int) (q->to - q->from) < 0)
+        q->to = q->from;
+}
+
+/* Move a few elements of q from its old ring to the new one, or from the spill
+ * list to the ring once the old one is released. Called on every insert and
+ * remove, which may free.
+ */
+static void ring_step(queue_t *q)
+{
+    for (int i = 0; i < RING_STEP && q->from != q->to; i++, q->from++)
+        q->ring[q->from & q->mask] = q->old[q->from & q->old_mask];
+    if (q->old) {
+        if (q->from == q->to) {
+            free(q->old);
+            q->old = NULL;
+        }
+        return;
+    }
+
+    for (int i = 0; i < RING_STEP && !list_empty(&q->spill) &&
+                    q->count <= (int) q->mask;
+         i++) {
+        element_t *e = list_first_entry(&q->spill, element_t, list);
+        list_del(&e->list);
+        q->ring[(q->first + q->count++) & q->mask] = e;
+    }
+}
+
+/* Give q a ring twice as large, leaving the elements in the old one for
+ * ring_step() to move
+ */
+static bool ring_grow(queue_t *q)
+{
+    /* The previous growth is over by now, short of a release */
+    while (q->old)
+        ring_step(q);
+
+    element_t **ring = malloc(2 * (q->mask + 1) * sizeof(element_t *));
+    if (!ring)
+        return false;
+    q->old = q->ring;
+    q->old_mask = q->mask;
+    q->from = q->first;
+    q->to = q->first + q->count;
+    q->ring = ring;
+    q->mask = 2 * q->mask + 1;
+    return true;
+}
+
+/* Link every element of q into list, in queue order, through their list
+ * member, leaving q empty
+ */
+int queue_unpack(struct list_head *head, struct list_head *list)
+{
+    queue_t *q = to_queue(head);
+    int n = q->size;
+    for (int i = 0; i < q->count; i++)
+        list_add_tail(&(*ring_at(q, i))->list, list);
+    list_splice_tail_init(&q->spill, list);
+    q->count = 0;
+    q->from = q->to;
+    q->size = 0;
+    return n;
+}
+
+/* Put the elements of list into the ring of q in order, spilling those which
+ * do not fit. Nothing is allocated.
+ */
+void queue_pack(struct list_head *head, struct list_head *list)
+{
+    queue_t *q = to_queue(head);
+    element_t *e, *safe;
+    q->first = 0;
+    list_for_each_entry_safe (e, safe, list, list) {
+        if (q->count <= (int) q->mask) {
+            list_del(&e->list);
+            q->ring[q->count++] = e;
+        }
+        q->size++;
+    }
+    list_splice_tail_init(list, &q->spill);
+}
+
+/* Swap the rings of to and from if the one of from is larger, so that to
+ * spills as few elements as it can
+ */
+void queue_hand_over(struct list_head *to, struct list_head *from)
+{
+    queue_t *t = to_queue(to), *f = to_queue(from);
+    if (f->mask > t->mask) {
+        element_t **ring = t->ring;
+        unsigned mask = t->mask;
+        t->ring = f->ring;
+        t->mask = f->mask;
+        f->ring = ring;
+        f->mask = mask;
+    }
+}
+
+/**
+ * ring_writer_t - Rewrite of a queue in place, keeping some of its elements
+ * @q: queue
+ * @room: slots of the ring which can be written, the number of elements in
+ * the ring when the rewrite started
+ * @n: number of elements kept so far
+ * @spill: elements kept past @room
+ *
+ * The elements are read in order with q_first() and q_next(), and the ones
+ * kept are written back, which never gets ahead of the reading.
+ */
+typedef struct {
+    queue_t *q;
+    int room, n;
+    struct list_head spill;
+} ring_writer_t;
+
+static void writer_init(ring_writer_t *w, queue_t *q)
+{
+    w->q = q;
+    w->room = q->count;
+    w->n = 0;
+    INIT_LIST_HEAD(&w->spill);
+}
+
+static void writer_put(ring_writer_t *w, element_t *e)
+{
+    if (w->n < w->room)
+        *ring_at(w->q, w->n) = e;
+    else
+        list_add_tail(&e->list, &w->spill);
+    w->n++;
+}
+
+/* Last element kept, which must exist */
+static element_t *writer_top(ring_writer_t *w)
+{
+    if (w->n <= w->room)
+        return *ring_at(w->q, w->n - 1);
+    return list_last_entry(&w->spill, element_t, list);
+}
+
+/* Take back the last element kept */
+static void writer_pop(ring_writer_t *w)
+{
+    if (--w->n >= w->room)
+        list_del(w->spill.prev);
+}
+
+static void writer_done(ring_writer_t *w)
+{
+    queue_t *q = w->q;
+    q->count = w->n < w->room ? w->n : w->room;
+    q->size = w->n;
+    INIT_LIST_HEAD(&q->spill);
+    list_splice(&w->spill, &q->spill);
+    ring_clip(q);
+}
+
+/* Create an empty queue */
+struct list_head *q_new()
+{
+    queue_t *q = malloc(sizeof(queue_t));
+    if (!q)
+        return NULL;
+
+    /* Start with a ring, so that the first inserts do not allocate one */
+    q->ring = malloc(RING_MIN_SLOTS * sizeof(element_t *));
+    if (!q->ring) {
+        free(q);
+        return NULL;
+    }
+    if (!element_store_init(&q->store)) {
+        free(q->ring);
+        free(q);
+        return NULL;
+    }
+    INIT_LIST_HEAD(&q->head);
+    INIT_LIST_HEAD(&q->spill);
+    q->size = q->count = 0;
+    q->mask = RING_MIN_SLOTS - 1;
+    q->first = q->from = q->to = 0;
+    q->old = NULL;
+    return &q->head;
+}
+
+/* Free all storage used by queue */
+void q_free(struct list_head *l)
+{
+    if (!l)
+        return;
+
+    queue_t *q = to_queue(l);
+#ifndef QUEUE_USE_ARENA
+    for (int i = 0; i < q->count; i++)
+        q_release_element(*ring_at(q, i));
+    element_t *e, *safe;
+    list_for_each_entry_safe (e, safe, &q->spill, list)
+        q_release_element(e);
+#endif
+    free(q->old);
+    free(q->ring);
+    /* With QUEUE_USE_ARENA, the elements go with the store as a whole */
+    element_store_free(&q->store);
+    free(q);
+}
+
+/* Insert an element at head of queue */
+bool q_insert_head(struct list_head *head, char *s)
+{
+    if (!head || !s)
+        return false;
+
+    queue_t *q = to_queue(head);
+    ring_step(q);
+    if (q->count > (int) q->mask && !ring_grow(q))
+        return false;
+
+    element_t *e = element_new(&q->store, s);
+    if (!e)
+        return false;
+    q->ring[--q->first & q->mask] = e;
+    q->count++;
+    q->size++;
+    return true;
+}
+
+/* Insert an element at tail of queue */
+bool q_insert_tail(struct list_head *head, char *s)
+{
+    if (!head || !s)
+        return false;
+
+    queue_t *q = to_queue(head);
+    ring_step(q);
+    if (!list_empty(&q->spill)) {
+        /* Behind the spilled ones, with a larger ring on the way to drain
+         * them if none is yet
+         */
+        element_t *e = element_new(&q->store, s);
+        if (!e)
+            return false;
+        list_add_tail(&e->list, &q->spill);
+        q->size++;
+        if (!q->old && q->count > (int) q->mask)
+            ring_grow(q);
+        return true;
+    }
+    if (q->count > (int) q->mask && !ring_grow(q))
+        return false;
+
+    element_t *e = element_new(&q->store, s);
+    if (!e)
+        return false;
+    q->ring[(q->first + q->count++) & q->mask] = e;
+    q->size++;
+    return true;
+}
+
+/* Copy the string of removed element e to sp (up to bufsize - 1 characters) */
+static element_t *removed(element_t *e, char *sp, size_t bufsize)
+{
+    if (sp && bufsize) {
+        strncpy(sp, e->value, bufsize - 1);
+        sp[bufsize - 1] = '\0';
+    }
+    return e;
+}
+
+/* Remove an element from head of queue */
+element_t *q_remove_head(struct list_head *head, char *sp, size_t bufsize)
+{
+    if (!head || !to_queue(head)->size)
+        return NULL;
+
+    queue_t *q = to_queue(head);
+    ring_step(q);
+    element_t *e;
+    if (q->count) {
+        e = *ring_at(q, 0);
+        q->first++;
+        q->count--;
+        ring_clip(q);
+    } else {
+        e = list_first_entry(&q->spill, element_t, list);
+        list_del(&e->list);
+    }
+    q->size--;
+    return removed(e, sp, bufsize);
+}
+
+/* Remove an element from tail of queue */
+element_t *q_remove_tail(struct list_head *head, char *sp, size_t bufsize)
+{
+    if (!head || !to_queue(head)->size)
+        return NULL;
+
+    queue_t *q = to_queue(head);
+    ring_step(q);
+    element_t *e;
+    if (list_empty(&q->spill)) {
+        e = *ring_at(q, --q->count);
+        ring_clip(q);
+    } else {
+        e = list_last_entry(&q->spill, element_t, list);
+        list_del(&e->list);
+    }
+    q->size--;
+    return removed(e, sp, bufsize);
+}
+
+/* Start a walk of queue at its head. The iterator holds the position in the
+ * ring in slot, with node NULL, then the node of the spilled element.
+ */
+element_t *q_first(struct list_head *head, q_iter_t *it)
+{
+    it->head = it->node = head;
+    if (!head || !to_queue(head)->size)
+        return NULL;
+
+    queue_t *q = to_queue(head);
+    if (q->count) {
+        it->node = NULL;
+        it->slot = 0;
+        return *ring_at(q, 0);
+    }
+    it->node = q->spill.next;
+    return list_entry(it->node, element_t, list);
+}
+
+/* Step to the next element of a walk */
+element_t *q_next(q_iter_t *it)
+{
+    if (it->node == it->head)
+        return NULL;
+
+    queue_t *q = to_queue(it->head);
+    if (!it->node) {
+        if (++it->slot < q->count)
+            return *ring_at(q, it->slot);
+        it->node = q->spill.next;
+    } else {
+        it->node = it->node->next;
+    }
+    if (it->node == &q->spill) {
+        it->node = it->head;
+        return NULL;
+    }
+    return list_entry(it->node, element_t, list);
+}
+
+/* Get the element at tail of queue */
+element_t *q_last(struct list_head *head)
+{
+    if (!head || !to_queue(head)->size)
+        return NULL;
+
+    queue_t *q = to_queue(head);
+    if (!list_empty(&q->spill))
+        return list_last_entry(&q->spill, element_t, list);
+    return *ring_at(q, q->count - 1);
+}
+
+/* Return number of elements in queue */
+int q_size(struct list_head *head)
+{
+    if (!head)
+        return 0;
+
+    queue_t *q = to_queue(head);
+    if (size_check) {
+        int len = q->count;
+        struct list_head *node;
+        list_for_each (node, &q->spill)
+            len++;
+        if (len != q->size)
+            report_event(MSG_ERROR,
+                         "Cached queue size is %d, but the queue holds %d "
+                         "elements",
+                         q->size, len);
+    }
+    return q->size;
+}
+
+/* Take the element at position i of the ring out of queue q, closing the gap
+ * from the shorter side of the ring
+ */
+static element_t *ring_take(queue_t *q, int i)
+{
+    element_t *e = *ring_at(q, i);
+    if (i < q->count - 1 - i) {
+        for (; i > 0; i--)
+            *ring_at(q, i) = *ring_at(q, i - 1);
+        q->first++;
+    } else {
+        for (; i < q->count - 1; i++)
+            *ring_at(q, i) = *ring_at(q, i + 1);
+    }
+    q->count--;
+    q->size--;
+    ring_clip(q);
+    return e;
+}
+
+/* Delete the middle node in queue */
+bool q_delete_mid(struct list_head *head)
+{
+    // https://leetcode.com/problems/delete-the-middle-node-of-a-linked-list/
+    if (!head || !to_queue(head)->size)
+        return false;
+
+    queue_t *q = to_queue(head);
+    int i = q->size / 2;
+    if (i >= q->count) {
+        struct list_head *node = q->spill.next;
+        for (i -= q->count; i; i--)
+            node = node->next;
+        list_del(node);
+        q_release_element(list_entry(node, element_t, list));
+        q->size--;
+        return true;
+    }
+
+    q_release_element(ring_take(q, i));
+    return true;
+}
+
+/* Delete all elements whose string is found more than once in queue q */
+static bool queue_delete_dup_hash(queue_t *q)
+{
+    dup_table_t t;
+    if (!dup_table_init(&t, q->size))
+        return false;
+
+    ring_writer_t w;
+    q_iter_t it;
+    for (element_t *e = q_first(&q->head, &it); e; e = q_next(&it))
+        dup_table_add(&t, e);
+    writer_init(&w, q);
+    for (element_t *e = q_first(&q->head, &it), *next; e; e = next) {
+        next = q_next(&it);
+        if (dup_table_next(&t))
+            q_release_element(e);
+        else
+            writer_put(&w, e);
+    }
+    writer_done(&w);
+    dup_table_free(&t);
+    return true;
+}
+
+/* Delete all nodes that have duplicate string */
+bool q_delete_dup(struct list_head *head)
+{
+    // https://leetcode.com/problems/remove-duplicates-from-sorted-list-ii/
+    if (!head)
+        return false;
+
+    if (dedup_hash)
+        return queue_delete_dup_hash(to_queue(head));
+
+    ring_writer_t w;
+    q_iter_t it;
+    writer_init(&w, to_queue(head));
+    bool dup = false;
+    for (element_t *e = q_first(head, &it), *next; e; e = next) {
+        next = q_next(&it);
+        if (next && !strcmp(e->value, next->value)) {
+            q_release_element(e);
+            dup = true;
+        } else if (dup) {
+            q_release_element(e);
+            dup = false;
+        } else {
+            writer_put(&w, e);
+        }
+    }
+    writer_done(&w);
+    return true;
+}
+
+/* Reverse elements in queue */
+void q_reverse(struct list_head *head)
+{
+    if (!head)
+        return;
+
+    q_reverseK(head, to_queue(head)->size);
+}
+
+/* Reverse the nodes of the list k at a time */
+void q_reverseK(struct list_head *head, int k)
+{
+    // https://leetcode.com/problems/reverse-nodes-in-k-group/
+    if (!head || k < 2)
+        return;
+
+    queue_t *q = to_queue(head);
+    if (list_empty(&q->spill)) {
+        /* Swap the slots of each group from both of its ends inward */
+        for (int lo = 0; lo + k <= q->count; lo += k) {
+            for (int i = lo, j = lo + k - 1; i < j; i++, j--) {
+                element_t *tmp = *ring_at(q, i);
+                *ring_at(q, i) = *ring_at(q, j);
+                *ring_at(q, j) = tmp;
+            }
+        }
+        return;
+    }
+
+    /* Groups may straddle the spill list, relink them all on a list */
+    LIST_HEAD(list);
+    LIST_HEAD(done);
+    int left = q->size;
+    queue_unpack(head, &list);
+    for (; left >= k; left -= k) {
+        LIST_HEAD(group);
+        for (int i = 0; i < k; i++)
+            list_move(list.next, &group);
+        list_splice_tail(&group, &done);
+    }
+    list_splice(&done, &list);
+    queue_pack(head, &list);
+}
+
+/* Bisect the ring, then walk the spilled elements if s goes after all of it */
+element_t *queue_search(struct list_head *head,
+                        const char *s,
+                        bool after,
+                        q_iter_t *it)
+{
+    queue_t *q = to_queue(head);
+    int lo = 0, hi = q->count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        int cmp = strcmp((*ring_at(q, mid))->value, s);
+        if (cmp > 0 || (!after && !cmp))
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    it->head = head;
+    if (lo < q->count) {
+        it->node = NULL;
+        it->slot = lo;
+        return *ring_at(q, lo);
+    }
+
+    it->node = search_elements(&q->spill, s, after);
+    if (it->node == &q->spill) {
+        it->node = head;
+        return NULL;
+    }
+    return list_entry(it->node, element_t, list);
+}
+
+/* Insert a copy of s before the position of it. In the ring, the element goes
+ * in at the nearer end, then the ones between that end and its place shift
+ * by one slot.
+ */
+bool queue_insert_at(q_iter_t *it, char *s)
+{
+    struct list_head *head = it->head;
+    queue_t *q = to_queue(head);
+    if (it->node == head)
+        return q_insert_tail(head, s);
+    if (it->node) {
+        element_t *e = element_new(&q->store, s);
+        if (!e)
+            return false;
+        list_add_tail(&e->list, it->node);
+        q->size++;
+        return true;
+    }
+
+    /* The tail of the ring is only reachable while nothing is spilled */
+    int i = it->slot;
+    if (i < q->count - i || !list_empty(&q->spill)) {
+        if (!q_insert_head(head, s))
+            return false;
+        element_t *e = *ring_at(q, 0);
+        for (int j = 0; j < i; j++)
+            *ring_at(q, j) = *ring_at(q, j + 1);
+        *ring_at(q, i) = e;
+    } else {
+        if (!q_insert_tail(head, s))
+            return false;
+        element_t *e = *ring_at(q, q->count - 1);
+        for (int j = q->count - 1; j > i; j--)
+            *ring_at(q, j) = *ring_at(q, j - 1);
+        *ring_at(q, i) = e;
+    }
+    return true;
+}
+
+element_t *queue_remove_at(q_iter_t *it)
+{
+    queue_t *q = to_queue(it->head);
+    if (!it->node)
+        return ring_take(q, it->slot);
+
+    list_del(it->node);
+    q->size--;
+    return list_entry(it->node, element_t, list);
+}
+
+/* Remove every node which has a node with a strictly greater value anywhere to
+ * the right side of it */
+int q_descend(struct list_head *head)
+{
+    // https://leetcode.com/problems/remove-nodes-from-linked-list/
+    if (!head || !to_queue(head)->size)
+        return 0;
+
+    /* Keep a stack of the elements with nothing greater after them so far,
+     * each new element dropping the smaller ones from its top
+     */
+    ring_writer_t w;
+    q_iter_t it;
+    writer_init(&w, to_queue(head));
+    for (element_t *e = q_first(head, &it), *next; e; e = next) {
+        next = q_next(&it);
+        while (w.n && strcmp(writer_top(&w)->value, e->value) < 0) {
+            element_t *top = writer_top(&w);
+            writer_pop(&w);
+            q_release_element(top);
+        }
+        writer_put(&w, e);
+    }
+    writer_done(&w);
+    return w.n;
+}
@@ -0,0 +1,684 @@
+/* Sorting and merging of lists of queue elements, shared by the backends of
+ * the queue
+ */
+
+#include <pthread.h>
+#include <signal.h>
+#include <string.h>
+
+#include "queue_sort.h"
+
+/* Sorting algorithm used by q_sort() */
+int sort_algo = SORT_LIST_SORT;
+
+/* Number of threads q_sort() runs on */
+int sort_threads = 1;
+
+/* Number of comparisons made by the last q_sort() */
+size_t sort_compares = 0;
+
+/* Compare the strings of two elements from their byte at depth on, given that
+ * they agree on the bytes before. With QUEUE_KEY_PREFIX, the keys settle it
+ * unless the strings match on all of their first 8 bytes.
+ */
+static inline int element_cmp_at(const element_t *x,
+                                 const element_t *y,
+                                 size_t depth)
+{
+#ifdef QUEUE_KEY_PREFIX
+    if (depth < 8) {
+        uint64_t kx = x->key << (8 * depth), ky = y->key << (8 * depth);
+        if (kx != ky)
+            return (kx > ky) - (kx < ky);
+        /* Equal keys holding a NUL are equal strings */
+        if (!(x->key & 0xff))
+            return 0;
+        depth = 8;
+    }
+#endif
+    return strcmp(x->value + depth, y->value + depth);
+}
+
+/* Order two nodes by the strings of their elements */
+int element_cmp(void *priv,
+                const struct list_head *a,
+                const struct list_head *b)
+{
+    if (priv)
+        (*(size_t *) priv)++;
+    return element_cmp_at(list_entry(a, element_t, list),
+                          list_entry(b, element_t, list), 0);
+}
+
+/* Merge two sorted, NULL-terminated singly-linked lists (next pointers only) */
+static struct list_head *merge_two(void *priv,
+                                   struct list_head *a,
+                                   struct list_head *b)
+{
+    struct list_head *head = NULL, **tail = &head;
+
+    while (a && b) {
+        /* Take from a on ties to keep the sort stable */
+        if (element_cmp(priv, a, b) <= 0) {
+            *tail = a;
+            a = a->next;
+        } else {
+            *tail = b;
+            b = b->next;
+        }
+        tail = &(*tail)->next;
+    }
+    *tail = a ? a : b;
+    return head;
+}
+
+/* Top-down merge sort on a NULL-terminated singly-linked list */
+static struct list_head *merge_sort(void *priv, struct list_head *list)
+{
+    if (!list || !list->next)
+        return list;
+
+    struct list_head *slow = list, *fast = list->next;
+    while (fast && fast->next) {
+        slow = slow->next;
+        fast = fast->next->next;
+    }
+    struct list_head *right = slow->next;
+    slow->next = NULL;
+
+    return merge_two(priv, merge_sort(priv, list), merge_sort(priv, right));
+}
+
+/* Restore the prev pointers of a NULL-terminated list and close it onto head */
+static void rebuild_prev(struct list_head *head, struct list_head *list)
+{
+    struct list_head *prev = head;
+    for (; list; list = list->next) {
+        prev->next = list;
+        list->prev = prev;
+        prev = list;
+    }
+    prev->next = head;
+    head->prev = prev;
+}
+
+/* Lists at most this long are sorted by insertion in radix_sort() */
+#define RADIX_INSERTION_SORT 16
+
+/* Compare the strings of two nodes from their byte at depth on */
+static inline int element_cmp_from(size_t *compares,
+                                   const struct list_head *a,
+                                   const struct list_head *b,
+                                   size_t depth)
+{
+    (*compares)++;
+    return element_cmp_at(list_entry(a, element_t, list),
+                          list_entry(b, element_t, list), depth);
+}
+
+/* Stable insertion sort of a list whose strings share their first depth
+ * bytes
+ */
+static void insertion_sort(size_t *compares,
+                           struct list_head *head,
+                           size_t depth)
+{
+    struct list_head *node, *safe;
+
+    list_for_each_safe (node, safe, head) {
+        struct list_head *pos = node->prev;
+        while (pos != head && element_cmp_from(compares, pos, node, depth) > 0)
+            pos = pos->prev;
+        if (pos != node->prev)
+            list_move(node, pos);
+    }
+}
+
+/* Byte of the string of an element at depth, not beyond its NUL */
+static inline unsigned char element_byte(const element_t *e, size_t depth)
+{
+#ifdef QUEUE_KEY_PREFIX
+    if (depth < 8)
+        return e->key >> (56 - 8 * depth);
+#endif
+    return e->value[depth];
+}
+
+/* Length of the prefix shared by all strings of a non-empty list from their
+ * byte at depth on
+ */
+static size_t common_prefix(struct list_head *head, size_t depth)
+{
+    const char *first = list_first_entry(head, element_t, list)->value + depth;
+    size_t len = strlen(first);
+    element_t *e;
+
+    list_for_each_entry (e, head, list) {
+        const char *s = e->value + depth;
+        size_t i = 0;
+        while (i < len && s[i] == first[i])
+            i++;
+        len = i;
+        if (!len)
+            break;
+    }
+    return len;
+}
+
+static void radix_sort(size_t *compares, struct list_head *head, size_t depth);
+
+/* Sort a bucket of count nodes, whose strings share their first depth bytes */
+static inline void radix_sort_bucket(size_t *compares,
+                                     struct list_head *bucket,
+                                     size_t count,
+                                     size_t depth)
+{
+    if (count <= RADIX_INSERTION_SORT)
+        insertion_sort(compares, bucket, depth);
+    else
+        radix_sort(compares, bucket, depth);
+}
+
+/* MSD radix sort of a list whose strings share their first depth bytes.
+ *
+ * Each pass skips the bytes all strings still share, then distributes the
+ * nodes into buckets on the next byte. Strings ending there are all equal and
+ * done. Every other bucket but the largest is sorted recursively, and the pass
+ * moves on to the next byte of the largest, so the recursion is at most
+ * log2(n) deep however long the strings are. Buckets sorted so far are kept
+ * in order in before and after meanwhile.
+ */
+static void radix_sort(size_t *compares, struct list_head *head, size_t depth)
+{
+    struct list_head buckets[256];
+    size_t count[256];
+    LIST_HEAD(before);
+    LIST_HEAD(after);
+
+    while (!list_empty(head)) {
+        struct list_head *node, *safe;
+        int largest = 1;
+
+        depth += common_prefix(head, depth);
+        for (int c = 0; c < 256; c++) {
+            INIT_LIST_HEAD(&buckets[c]);
+            count[c] = 0;
+        }
+        list_for_each_safe (node, safe, head) {
+            unsigned char c = element_byte(list_entry(node, element_t, list),
+                                           depth);
+            list_move_tail(node, &buckets[c]);
+            count[c]++;
+        }
+
+        for (int c = 2; c < 256; c++) {
+            if (count[c] > count[largest])
+                largest = c;
+        }
+
+        list_splice_tail(&buckets[0], &before);
+        for (int c = 1; c < largest; c++) {
+            if (!count[c])
+                continue;
+            radix_sort_bucket(compares, &buckets[c], count[c], depth + 1);
+            list_splice_tail(&buckets[c], &before);
+        }
+        for (int c = 255; c > largest; c--) {
+            if (!count[c])
+                continue;
+            radix_sort_bucket(compares, &buckets[c], count[c], depth + 1);
+            list_splice(&buckets[c], &after);
+        }
+
+        list_splice(&buckets[largest], head);
+        depth++;
+        if (count[largest] <= RADIX_INSERTION_SORT) {
+            insertion_sort(compares, head, depth);
+            break;
+        }
+    }
+
+    list_splice(&before, head);
+    list_splice_tail(&after, head);
+}
+
+/* Sort a queue with sort_algo on the calling thread, counting comparisons */
+static void sort_segment(size_t *compares, struct list_head *head)
+{
+    if (list_empty(head) || list_is_singular(head))
+        return;
+
+    switch (sort_algo) {
+    case SORT_TOP_DOWN:
+        head->prev->next = NULL;
+        rebuild_prev(head, merge_sort(compares, head->next));
+        break;
+    case SORT_ADAPTIVE:
+        list_sort_adaptive(compares, head, element_cmp);
+        break;
+    case SORT_RADIX:
+        radix_sort(compares, head, 0);
+        break;
+    default:
+        list_sort(compares, head, element_cmp);
+    }
+}
+
+/* Merge sorted list other into sorted list head in place */
+void merge_elements(size_t *compares,
+                    struct list_head *head,
+                    struct list_head *other)
+{
+    struct list_head *a = head->next, *b, *safe;
+
+    list_for_each_safe (b, safe, other) {
+        while (a != head && element_cmp(compares, a, b) <= 0)
+            a = a->next;
+        if (a == head)
+            break;
+        list_move_tail(b, a);
+    }
+    list_splice_tail_init(other, head);
+}
+
+/* Copy the strings of a list of elements one after another */
+void pack_strings(struct list_head *head, char *sp, size_t bufsize)
+{
+    if (!sp || !bufsize)
+        return;
+
+    element_t *e;
+    list_for_each_entry (e, head, list) {
+        size_t len = strlen(e->value) + 1;
+        if (len > bufsize) {
+            memcpy(sp, e->value, bufsize - 1);
+            sp[bufsize - 1] = '\0';
+            return;
+        }
+        memcpy(sp, e->value, len);
+        sp += len;
+        bufsize -= len;
+        if (!bufsize)
+            return;
+    }
+}
+
+/* Upper bound of the number of threads a parallel sort uses */
+#define MAX_SORT_THREADS 64
+
+/* Segments shorter than this are not worth a thread of their own */
+#define MIN_SORT_SEGMENT 4096
+
+/**
+ * sort_task_t - Work of one thread in a parallel sort
+ * @head: segment of the queue, never empty
+ * @other: sorted segment to merge into @head, or NULL to sort @head
+ * @compares: comparisons made by the task
+ */
+typedef struct {
+    struct list_head head;
+    struct list_head *other;
+    size_t compares;
+} sort_task_t;
+
+static void sort_task_run(sort_task_t *t)
+{
+    /* Count locally, tasks share cache lines */
+    size_t compares = 0;
+
+    if (!t->other) {
+        sort_segment(&compares, &t->head);
+    } else {
+        merge_elements(&compares, &t->head, t->other);
+    }
+    t->compares += compares;
+}
+
+/**
+ * sort_worker_t - Thread kept for parallel sorts, waiting for tasks
+ * @thread: the thread
+ * @task: task handed to the thread, NULL once it is done
+ */
+typedef struct {
+    pthread_t thread;
+    sort_task_t *task;
+} sort_worker_t;
+
+/* Workers started so far, reused by every parallel sort. Tasks are handed out
+ * and waited for under sort_lock.
+ */
+static sort_worker_t sort_workers[MAX_SORT_THREADS - 1];
+static int nr_sort_workers = 0, nr_sort_pending = 0;
+static pthread_mutex_t sort_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sort_work = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t sort_done = PTHREAD_COND_INITIALIZER;
+
+static void *sort_worker_run(void *arg)
+{
+    sort_worker_t *w = arg;
+
+    pthread_mutex_lock(&sort_lock);
+    for (;;) {
+        while (!w->task)
+            pthread_cond_wait(&sort_work, &sort_lock);
+        pthread_mutex_unlock(&sort_lock);
+        sort_task_run(w->task);
+        pthread_mutex_lock(&sort_lock);
+        w->task = NULL;
+        if (!--nr_sort_pending)
+            pthread_cond_signal(&sort_done);
+    }
+    return NULL;
+}
+
+/* Start workers until there are nr of them, or as many as could be started */
+static int sort_workers_start(int nr)
+{
+    sigset_t all, old;
+
+    /* Keep signals, notably the SIGALRM of the time limit of qtest, on the
+     * calling thread: their handlers may longjmp back into it.
+     */
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &old);
+    while (nr_sort_workers < nr) {
+        sort_worker_t *w = &sort_workers[nr_sort_workers];
+        w->task = NULL;
+        if (pthread_create(&w->thread, NULL, sort_worker_run, w))
+            break;
+        nr_sort_workers++;
+    }
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    return nr_sort_workers;
+}
+
+/* Run every stride-th task below nr concurrently, the first one on the
+ * calling thread and the others on the workers.
+ */
+static void sort_tasks_run(sort_task_t *tasks, int nr, int stride)
+{
+    int nr_workers = sort_workers_start((nr - 1) / stride);
+    int i = stride;
+
+    pthread_mutex_lock(&sort_lock);
+    for (int w = 0; w < nr_workers && i < nr; w++, i += stride) {
+        sort_workers[w].task = &tasks[i];
+        nr_sort_pending++;
+    }
+    pthread_cond_broadcast(&sort_work);
+    pthread_mutex_unlock(&sort_lock);
+
+    sort_task_run(&tasks[0]);
+    for (; i < nr; i += stride)
+        sort_task_run(&tasks[i]); /* out of workers, do it here */
+
+    pthread_mutex_lock(&sort_lock);
+    while (nr_sort_pending)
+        pthread_cond_wait(&sort_done, &sort_lock);
+    pthread_mutex_unlock(&sort_lock);
+}
+
+/* Sort with up to sort_threads threads. Nothing is allocated per element, the
+ * segments are linked in place, so this also works in noallocate mode.
+ */
+static void sort_parallel(struct list_head *head, int n)
+{
+    sort_task_t tasks[MAX_SORT_THREADS];
+    int nr = sort_threads < MAX_SORT_THREADS ? sort_threads : MAX_SORT_THREADS;
+    sigset_t sigalrm, old;
+
+    if (nr > n / MIN_SORT_SEGMENT)
+        nr = n / MIN_SORT_SEGMENT;
+    if (nr < 2) {
+        sort_segment(&sort_compares, head);
+        return;
+    }
+
+    /* Hold the SIGALRM of the time limit of qtest until every worker is
+     * done and the queue is whole again. Its handler longjmps out of here,
+     * which would leave workers sorting the segments in tasks.
+     */
+    sigemptyset(&sigalrm);
+    sigaddset(&sigalrm, SIGALRM);
+    pthread_sigmask(SIG_BLOCK, &sigalrm, &old);
+
+    /* Cut the queue into nr segments of nearly equal length */
+    for (int i = 0; i < nr; i++) {
+        struct list_head *node = head;
+        for (int len = n / nr + (i < n % nr); len; len--)
+            node = node->next;
+        INIT_LIST_HEAD(&tasks[i].head);
+        list_cut_position(&tasks[i].head, head, node);
+        tasks[i].other = NULL;
+        tasks[i].compares = 0;
+    }
+    sort_tasks_run(tasks, nr, 1);
+
+    /* Merge segment i + step into segment i, for every pair at once */
+    for (int step = 1; step < nr; step *= 2) {
+        for (int i = 0; i + step < nr; i += 2 * step)
+            tasks[i].other = &tasks[i + step].head;
+        sort_tasks_run(tasks, nr - step, 2 * step);
+    }
+
+    list_splice(&tasks[0].head, head);
+    for (int i = 0; i < nr; i++)
+        sort_compares += tasks[i].compares;
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+}
+
+/* Sort a list of n elements with sort_algo on sort_threads threads */
+void sort_elements(struct list_head *head, int n)
+{
+    if (n < 2)
+        return;
+
+    if (sort_threads > 1)
+        sort_parallel(head, n);
+    else
+        sort_segment(&sort_compares, head);
+}
+
+static void drop_element(struct list_head *node)
+{
+    q_release_element(list_entry(node, element_t, list));
+}
+
+/* Release every group of equal strings from a sorted list, in one walk.
+ * Return the number of elements released.
+ */
+static int drop_dups(struct list_head *head)
+{
+    struct list_head *node = head->next;
+    int dropped = 0;
+
+    while (node != head) {
+        struct list_head *next = node->next;
+        if (next == head || element_cmp(&sort_compares, node, next)) {
+            node = next;
+            continue;
+        }
+        while (next != head && !element_cmp(&sort_compares, node, next)) {
+            struct list_head *tmp = next->next;
+            list_del(next);
+            drop_element(next);
+            dropped++;
+            next = tmp;
+        }
+        list_del(node);
+        drop_element(node);
+        dropped++;
+        node = next;
+    }
+    return dropped;
+}
+
+/* Sort a list of n elements and drop the duplicates, in the final merge of
+ * list_sort() if it is the one to use
+ */
+int sort_unique_elements(struct list_head *head, int n)
+{
+    if (n < 2)
+        return n;
+
+    if (sort_algo == SORT_LIST_SORT && sort_threads <= 1)
+        return n - (int) list_sort_unique(&sort_compares, head, element_cmp,
+                                          drop_element);
+    sort_elements(head, n);
+    return n - drop_dups(head);
+}
+
+/* Lists at most this long are sorted by insertion in select_elements() */
+#define SELECT_INSERTION_SORT 8
+
+/* Median of the first, second and last elements of a list of 3 or more */
+static struct list_head *median_of_three(size_t *compares,
+                                         struct list_head *head)
+{
+    struct list_head *a = head->next, *b = a->next, *c = head->prev;
+
+    if (element_cmp(compares, a, b) > 0) {
+        struct list_head *tmp = a;
+        a = b;
+        b = tmp;
+    }
+    /* a <= b, the median is b unless c is below it */
+    if (element_cmp(compares, b, c) <= 0)
+        return b;
+    return element_cmp(compares, a, c) >= 0 ? a : c;
+}
+
+static element_t *select_list(size_t *compares,
+                              struct list_head *head,
+                              int n,
+                              int k);
+
+/* Median of the medians of the groups of 5 elements of a list, which has at
+ * least 3/10 of the list on either side of it
+ */
+static struct list_head *median_of_medians(size_t *compares,
+                                           struct list_head *head)
+{
+    LIST_HEAD(medians);
+    struct list_head *node = head->next;
+    int m = 0;
+
+    while (node != head) {
+        LIST_HEAD(group);
+        int g = 0;
+        for (; g < 5 && node != head; g++) {
+            struct list_head *next = node->next;
+            list_move_tail(node, &group);
+            node = next;
+        }
+        insertion_sort(compares, &group, 0);
+        struct list_head *median = group.next;
+        for (int i = 0; i < g / 2; i++)
+            median = median->next;
+        list_move_tail(median, &medians);
+        /* Put the group back where it was taken from */
+        list_splice_tail(&group, node);
+        m++;
+    }
+
+    element_t *pivot = select_list(compares, &medians, m, m / 2);
+    list_splice_tail(&medians, head);
+    return &pivot->list;
+}
+
+/* Find the element at index k once a list of n elements is sorted, and
+ * partition the list around it, as select_elements() does
+ */
+static element_t *select_list(size_t *compares,
+                              struct list_head *head,
+                              int n,
+                              int k)
+{
+    LIST_HEAD(before); /* elements below the ones left, in no order */
+    LIST_HEAD(after);  /* elements above the ones left, in no order */
+    element_t *found = NULL;
+    bool linear = false;
+
+    while (!found) {
+        if (n <= SELECT_INSERTION_SORT) {
+            insertion_sort(compares, head, 0);
+            struct list_head *node = head->next;
+            for (int i = 0; i < k; i++)
+                node = node->next;
+            found = list_entry(node, element_t, list);
+            break;
+        }
+
+        /* Median of three is cheap and does well on most inputs. Once it
+         * fails to cut a quarter of the list, median of medians takes over,
+         * which bounds the whole at linear time.
+         */
+        struct list_head *pivot = linear ? median_of_medians(compares, head)
+                                         : median_of_three(compares, head);
+
+        /* Three-way partition: lt, head (equal to the pivot) then gt */
+        LIST_HEAD(lt);
+        LIST_HEAD(gt);
+        int nr_lt = 0, nr_gt = 0;
+        struct list_head *node, *safe;
+        list_for_each_safe (node, safe, head) {
+            if (node == pivot)
+                continue;
+            int cmp = element_cmp(compares, node, pivot);
+            if (cmp < 0) {
+                list_move_tail(node, &lt);
+                nr_lt++;
+            } else if (cmp > 0) {
+                list_move_tail(node, &gt);
+                nr_gt++;
+            }
+        }
+
+        int left;
+        if (k < nr_lt) {
+            list_splice(&gt, &after);
+            list_splice_init(head, &after);
+            list_splice(&lt, head);
+            left = nr_lt;
+        } else if (k >= n - nr_gt) {
+            list_splice_tail(&lt, &before);
+            list_splice_tail_init(head, &before);
+            list_splice(&gt, head);
+            k -= n - nr_gt;
+            left = nr_gt;
+        } else {
+            list_splice(&lt, head);
+            list_splice_tail(&gt, head);
+            found = list_entry(pivot, element_t, list);
+            break;
+        }
+        linear = left > n / 4 * 3;
+        n = left;
+    }
+
+    list_splice(&before, head);
+    list_splice_tail(&after, head);
+    return found;
+}
+
+/* Find the k-th smallest element of a list in expected linear time */
+element_t *select_elements(struct list_head *head, int n, int k)
+{
+    if (k < 0 || k >= n)
+        return NULL;
+    return select_list(&sort_compares, head, n, k);
+}
+
+/* Find the first element of a sorted list not below s, walking from its head */
+struct list_head *search_elements(struct list_head *head,
+                                  const char *s,
+                                  bool after)
+{
+    struct list_head *node;
+    list_for_each (node, head) {
+        int cmp = strcmp(list_entry(node, element_t, list)->value, s);
+        if (cmp > 0 || (cmp == 0 && !after))
+            break;
+    }
+    return node;
+}
@@ -0,0 +1,123 @@
+#ifndef LAB0_QUEUE_SORT_H
+#define LAB0_QUEUE_SORT_H
+
+/* Ordering of queue elements, and copying of their strings, shared by the
+ * backends of the queue: the list backend in queue.c and the array ones in
+ * queue_chunk.c and queue_ring.c. They all work on elements linked through
+ * their list member.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "list_sort.h"
+#include "queue.h"
+
+#ifdef QUEUE_KEY_PREFIX
+/* Pack the first 8 bytes of s, up to its NUL, into a big-endian integer */
+static inline uint64_t key_prefix(const char *s)
+{
+    uint64_t key = 0;
+    for (int i = 0; i < 8; i++) {
+        key = key << 8 | (unsigned char) *s;
+        if (*s)
+            s++;
+    }
+    return key;
+}
+#endif
+
+/**
+ * element_cmp() - Order two nodes by the strings of their elements
+ * @priv: counter of comparisons made, or NULL
+ * @a: node of an element
+ * @b: node of another element
+ *
+ * Return: less than, equal to or greater than zero, like strcmp()
+ */
+int element_cmp(void *priv,
+                const struct list_head *a,
+                const struct list_head *b);
+
+/**
+ * sort_elements() - Sort a list of elements in ascending order
+ * @head: header of the list
+ * @n: number of elements in the list
+ *
+ * The list is sorted with sort_algo, on up to sort_threads threads, and the
+ * comparisons made are added to sort_compares. Nothing is allocated.
+ */
+void sort_elements(struct list_head *head, int n);
+
+/**
+ * sort_unique_elements() - Sort a list of elements, keeping unique strings only
+ * @head: header of the list
+ * @n: number of elements in the list
+ *
+ * Sort like sort_elements(), and release every element whose string is found
+ * more than once, like q_delete_dup(). With list_sort on one thread, which is
+ * the default, the elements are released during the final merge, and the list
+ * is not walked again. The comparisons made are added to sort_compares.
+ *
+ * Return: the number of elements left.
+ */
+int sort_unique_elements(struct list_head *head, int n);
+
+/**
+ * select_elements() - Find the k-th smallest element of a list
+ * @head: header of the list
+ * @n: number of elements in the list
+ * @k: index of the element once the list is sorted, from 0
+ *
+ * Quickselect with a three-way partition, so that runs of equal strings cost
+ * no more than distinct ones. Pivots are the median of three elements, or of
+ * the medians of groups of 5 once a partition leaves more than 3/4 of the
+ * list, which keeps the worst case linear. The list is left partitioned:
+ * strings below the one found come first, then the ones equal to it, then
+ * the ones above. Nothing is allocated, and the comparisons made are added
+ * to sort_compares.
+ *
+ * Return: the element found, or NULL if @k is out of range.
+ */
+element_t *select_elements(struct list_head *head, int n, int k);
+
+/**
+ * search_elements() - Find where a string goes in a sorted list of elements
+ * @head: header of the list
+ * @s: string sought
+ * @after: skip the elements whose string equals @s too
+ *
+ * The list is walked from its head, in linear time.
+ *
+ * Return: the first node whose string is not below @s (above it if @after is
+ * set), or @head if there is none.
+ */
+struct list_head *search_elements(struct list_head *head,
+                                  const char *s,
+                                  bool after);
+
+/**
+ * merge_elements() - Merge a sorted list into another one, in place
+ * @compares: counter of comparisons made, or NULL
+ * @head: header of a sorted list, which receives the elements of @other
+ * @other: header of a sorted list, left empty
+ *
+ * Nodes of @head go first on ties, and whatever is left of @other once @head
+ * runs out is spliced at the tail at once.
+ */
+void merge_elements(size_t *compares,
+                    struct list_head *head,
+                    struct list_head *other);
+
+/**
+ * pack_strings() - Copy the strings of a list of elements to a buffer
+ * @head: header of the list
+ * @sp: buffer, or NULL to copy nothing
+ * @bufsize: size of @sp
+ *
+ * The strings are copied one after another, each with its NUL, as far as
+ * @bufsize bytes go. The last one copied may be cut short, NUL-terminated.
+ */
+void pack_strings(struct list_head *head, char *sp, size_t bufsize);
+
+#endif /* LAB0_QUEUE_SORT_H */
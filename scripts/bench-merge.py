@@ -0,0 +1,30 @@
+#!/usr/bin/env python3
+"""Generate the qtest trace of the k-way merge benchmark.
+
+Each run builds k sorted queues holding TOTAL random strings in all and
+merges them, for k from 2 up to 1024.
+"""
+
+from __future__ import print_function
+
+TOTAL = 131072
+KS = [2, 4, 16, 64, 256, 1024]
+
+
+def main():
+    print("# k-way merge of k sorted queues holding %d random strings in all"
+          % TOTAL)
+    print("option fail 0")
+    print("option malloc 0")
+    for k in KS:
+        for _ in range(k):
+            print("new")
+            print("ih RAND %d" % (TOTAL // k))
+            print("sort")
+        print("# k = %d" % k)
+        print("time merge")
+        print("free")
+
+
+if __name__ == "__main__":
+    main()
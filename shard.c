@@ -0,0 +1,128 @@
+#include <stdlib.h>
+
+/* Shards are shared by threads, use regular malloc/free */
+#define INTERNAL 1
+#include "queue_sort.h"
+#include "shard.h"
+
+/* Create nr empty shards */
+sharded_t *shard_new(int nr)
+{
+    sharded_t *s = malloc(sizeof(sharded_t));
+    if (!s)
+        return NULL;
+    s->shards = aligned_alloc(64, nr * sizeof(shard_t));
+    if (!s->shards) {
+        free(s);
+        return NULL;
+    }
+
+    s->nr = nr;
+    for (int i = 0; i < nr; i++) {
+        pthread_mutex_init(&s->shards[i].lock, NULL);
+        INIT_LIST_HEAD(&s->shards[i].head);
+        s->shards[i].size = 0;
+    }
+    return s;
+}
+
+/* Free the shards */
+void shard_free(sharded_t *s)
+{
+    if (!s)
+        return;
+    for (int i = 0; i < s->nr; i++)
+        pthread_mutex_destroy(&s->shards[i].lock);
+    free(s->shards);
+    free(s);
+}
+
+/* Insert an element at tail of a shard */
+void shard_insert(sharded_t *s, int id, element_t *e)
+{
+    shard_t *shard = &s->shards[id];
+
+    pthread_mutex_lock(&shard->lock);
+    list_add_tail(&e->list, &shard->head);
+    shard->size++;
+    pthread_mutex_unlock(&shard->lock);
+}
+
+/* Move the tail half of victim, rounded up, to the list stolen. Return how
+ * many elements moved.
+ */
+static int shard_steal(shard_t *victim, struct list_head *stolen)
+{
+    pthread_mutex_lock(&victim->lock);
+    int n = (victim->size + 1) / 2;
+    if (n) {
+        /* Walk back from the tail to the last node kept */
+        struct list_head *keep = victim->head.prev, kept;
+        for (int i = 0; i < n; i++)
+            keep = keep->prev;
+
+        list_cut_position(&kept, &victim->head, keep);
+        list_splice_tail_init(&victim->head, stolen);
+        list_splice_init(&kept, &victim->head);
+        victim->size -= n;
+    }
+    pthread_mutex_unlock(&victim->lock);
+    return n;
+}
+
+/* Remove an element from head of a shard, or steal some */
+element_t *shard_remove(sharded_t *s, int id)
+{
+    shard_t *shard = &s->shards[id];
+    element_t *e = NULL;
+
+    pthread_mutex_lock(&shard->lock);
+    if (shard->size) {
+        e = list_first_entry(&shard->head, element_t, list);
+        list_del(&e->list);
+        shard->size--;
+    }
+    pthread_mutex_unlock(&shard->lock);
+    if (e)
+        return e;
+
+    /* Never hold two locks: steal into a list of our own first */
+    LIST_HEAD(stolen);
+    int n = 0;
+    for (int i = 1; !n && i < s->nr; i++)
+        n = shard_steal(&s->shards[(id + i) % s->nr], &stolen);
+    if (!n)
+        return NULL;
+
+    e = list_first_entry(&stolen, element_t, list);
+    list_del(&e->list);
+    if (n > 1) {
+        pthread_mutex_lock(&shard->lock);
+        list_splice_tail_init(&stolen, &shard->head);
+        shard->size += n - 1;
+        pthread_mutex_unlock(&shard->lock);
+    }
+    return e;
+}
+
+/* Sort all elements into one list */
+int shard_drain(sharded_t *s, struct list_head *head)
+{
+    int n = 0;
+
+    for (int i = 0; i < s->nr; i++) {
+        sort_elements(&s->shards[i].head, s->shards[i].size);
+        n += s->shards[i].size;
+        s->shards[i].size = 0;
+    }
+
+    /* Merge pairwise with step doubling, like q_merge() does with queues */
+    for (int step = 1; step < s->nr; step *= 2) {
+        for (int i = 0; i + step < s->nr; i += 2 * step)
+            merge_elements(NULL, &s->shards[i].head,
+                           &s->shards[i + step].head);
+    }
+    if (s->nr)
+        list_splice_tail_init(&s->shards[0].head, head);
+    return n;
+}
@@ -0,0 +1,62 @@
+#ifndef LAB0_SHARD_H
+#define LAB0_SHARD_H
+
+#include <pthread.h>
+#include <stdbool.h>
+
+#include "queue.h"
+
+/* Concurrent pool of queue elements split into shards, one per thread, so
+ * that threads inserting never share a cache line.
+ *
+ * A thread inserts at the tail of its own shard and removes from its head.
+ * Once its shard is empty, it steals half of the elements of another shard,
+ * from its tail, in one list_splice_tail_init(). Each shard has a lock, which
+ * only thieves contend for. Elements are linked through their list member and
+ * stay owned by the caller.
+ *
+ * Order across shards is lost, shard_drain() sorts all elements back.
+ */
+
+/**
+ * shard_t - Elements of one thread
+ * @lock: guard of @head and @size
+ * @head: elements, in the order they were inserted
+ * @size: number of elements in @head
+ */
+typedef struct {
+    _Alignas(64) pthread_mutex_t lock;
+    struct list_head head;
+    int size;
+} shard_t;
+
+/**
+ * sharded_t - Sharded pool of elements
+ * @nr: number of shards
+ * @shards: shards, thread i using shard i
+ */
+typedef struct {
+    int nr;
+    shard_t *shards;
+} sharded_t;
+
+/* Create nr empty shards. Return NULL if allocation fails */
+sharded_t *shard_new(int nr);
+
+/* Free the shards. Elements left in them are not released */
+void shard_free(sharded_t *s);
+
+/* Insert element e at the tail of shard id */
+void shard_insert(sharded_t *s, int id, element_t *e);
+
+/* Remove the element at the head of shard id, stealing from the other shards
+ * if it is empty. Return NULL if all of them are.
+ */
+element_t *shard_remove(sharded_t *s, int id);
+
+/* Move the elements of all shards to the list head, in ascending order, and
+ * return how many there were. No thread may use s meanwhile.
+ */
+int shard_drain(sharded_t *s, struct list_head *head);
+
+#endif /* LAB0_SHARD_H */
@@ -0,0 +1,189 @@
+#include <string.h>
+
+#include "skiplist.h"
+
+/**
+ * skip_tower_t - Tower of an element
+ * @e: element
+ * @value: string of the element, saving searches a load of it
+ * @height: number of lanes the tower links into, from the lowest one
+ * @next: next tower in each of these lanes, or NULL
+ */
+struct __skip_tower {
+    element_t *e;
+    const char *value;
+    int height;
+    skip_tower_t *next[];
+};
+
+/* Height of a new tower: 0 three times out of four, then each next lane a
+ * quarter as often
+ */
+static int random_height(skiplist_t *s)
+{
+    /* xorshift64* */
+    s->seed ^= s->seed >> 12;
+    s->seed ^= s->seed << 25;
+    s->seed ^= s->seed >> 27;
+    uint64_t r = s->seed * 0x2545f4914f6cdd1dULL;
+
+    int height = 0;
+    while (height < SKIP_MAX_LEVEL && (r & 3) == 3) {
+        height++;
+        r >>= 2;
+    }
+    return height;
+}
+
+static skip_tower_t *tower_new(element_t *e, int height)
+{
+    skip_tower_t *t =
+        test_malloc(sizeof(skip_tower_t) + height * sizeof(skip_tower_t *));
+    if (!t)
+        return NULL;
+    t->e = e;
+    t->value = e->value;
+    t->height = height;
+    return t;
+}
+
+/* Find, in each lane, the last tower whose string is below str, or up to str
+ * if after is set. Return the one in the lowest lane, NULL if none.
+ */
+static skip_tower_t *find_before(skiplist_t *s,
+                                 const char *str,
+                                 bool after,
+                                 skip_tower_t ***prev)
+{
+    skip_tower_t **lane = s->lanes, *last = NULL;
+
+    for (int i = SKIP_MAX_LEVEL - 1; i >= 0; i--) {
+        skip_tower_t *t;
+        while ((t = lane[i])) {
+            int cmp = strcmp(t->value, str);
+            if (cmp > 0 || (cmp == 0 && !after))
+                break;
+            last = t;
+            lane = t->next;
+        }
+        if (prev)
+            prev[i] = &lane[i];
+    }
+    return last;
+}
+
+/* Append a tower to the lanes, whose last towers are *tail */
+static void tower_append(skip_tower_t ***tail, skip_tower_t *t)
+{
+    for (int i = 0; i < t->height; i++) {
+        t->next[i] = NULL;
+        *tail[i] = t;
+        tail[i] = &t->next[i];
+    }
+}
+
+skiplist_t *skip_new(struct list_head *head)
+{
+    skiplist_t *s = test_malloc(sizeof(skiplist_t));
+    if (!s)
+        return NULL;
+
+    s->head = head;
+    s->retired = NULL;
+    s->seed = (uintptr_t) head | 1;
+    memset(s->lanes, 0, sizeof(s->lanes));
+
+    skip_tower_t **tail[SKIP_MAX_LEVEL];
+    for (int i = 0; i < SKIP_MAX_LEVEL; i++)
+        tail[i] = &s->lanes[i];
+
+    element_t *e;
+    list_for_each_entry (e, head, list) {
+        int height = random_height(s);
+        skip_tower_t *t = height ? tower_new(e, height) : NULL;
+        if (t)
+            tower_append(tail, t);
+    }
+    return s;
+}
+
+/* Free a chain of towers linked through their lowest lane */
+static void towers_free(skip_tower_t *t)
+{
+    while (t) {
+        skip_tower_t *next = t->next[0];
+        test_free(t);
+        t = next;
+    }
+}
+
+void skip_free(skiplist_t *s)
+{
+    if (!s)
+        return;
+
+    /* Every tower is in the lowest lane, or retired */
+    towers_free(s->lanes[0]);
+    towers_free(s->retired);
+    test_free(s);
+}
+
+struct list_head *skip_search(skiplist_t *s, const char *str, bool after)
+{
+    skip_tower_t *last = find_before(s, str, after, NULL);
+    struct list_head *node = last ? last->e->list.next : s->head->next;
+
+    for (; node != s->head; node = node->next) {
+        int cmp = strcmp(list_entry(node, element_t, list)->value, str);
+        if (cmp > 0 || (cmp == 0 && !after))
+            break;
+    }
+    return node;
+}
+
+void skip_insert(skiplist_t *s, element_t *e)
+{
+    towers_free(s->retired);
+    s->retired = NULL;
+
+    skip_tower_t **prev[SKIP_MAX_LEVEL];
+    skip_tower_t *last = find_before(s, e->value, true, prev);
+
+    /* Walk the list from the last tower up to its string, as skip_search() */
+    struct list_head *node = last ? last->e->list.next : s->head->next;
+    for (; node != s->head; node = node->next) {
+        if (strcmp(list_entry(node, element_t, list)->value, e->value) > 0)
+            break;
+    }
+    list_add_tail(&e->list, node);
+
+    int height = random_height(s);
+    skip_tower_t *t = height ? tower_new(e, height) : NULL;
+    if (!t)
+        return;
+    for (int i = 0; i < height; i++) {
+        t->next[i] = *prev[i];
+        *prev[i] = t;
+    }
+}
+
+void skip_remove(skiplist_t *s, element_t *e)
+{
+    skip_tower_t **prev[SKIP_MAX_LEVEL];
+    find_before(s, e->value, false, prev);
+
+    /* Towers of equal strings come in list order, look for that of e */
+    skip_tower_t *t = *prev[0];
+    while (t && t->e != e && !strcmp(t->value, e->value))
+        t = t->next[0];
+    if (!t || t->e != e)
+        return;
+
+    for (int i = 0; i < t->height; i++) {
+        while (*prev[i] != t)
+            prev[i] = &(*prev[i])->next[i];
+        *prev[i] = t->next[i];
+    }
+    t->next[0] = s->retired;
+    s->retired = t;
+}
@@ -0,0 +1,68 @@
+#ifndef LAB0_SKIPLIST_H
+#define LAB0_SKIPLIST_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "queue.h"
+
+/* Skip list index over a sorted queue of elements, after Pugh, "Skip Lists: A
+ * Probabilistic Alternative to Balanced Trees" (CACM 1990).
+ *
+ * The bottom lane is the list of the queue itself, left alone for every other
+ * operation. About one element in four also gets a tower, allocated on the
+ * side, which links it to the next tower in each of the express lanes above,
+ * up to its height. A search runs down the lanes to the last tower before the
+ * string sought, then walks the few elements left in the list, in O(log n)
+ * expected time.
+ *
+ * Towers are optional: an element missing one, because it was inserted by
+ * other means or its allocation failed, only makes searches walk further.
+ *
+ * The lanes and towers come from test_malloc(). skip_remove() frees nothing,
+ * as it may run with allocation disallowed: it retires the tower it takes
+ * down, and the next skip_insert() or skip_free() frees it.
+ */
+
+/* Number of express lanes, enough for 4^16 elements */
+#define SKIP_MAX_LEVEL 16
+
+typedef struct __skip_tower skip_tower_t;
+
+/**
+ * skiplist_t - Express lanes over the list of a sorted queue
+ * @head: header of the list of the queue
+ * @lanes: first tower of each lane, NULL past the last one
+ * @seed: state of the generator of tower heights
+ * @retired: towers taken down by skip_remove(), linked through their lowest
+ * lane, not freed yet
+ */
+typedef struct {
+    struct list_head *head;
+    skip_tower_t *lanes[SKIP_MAX_LEVEL];
+    uint64_t seed;
+    skip_tower_t *retired;
+} skiplist_t;
+
+/* Build the lanes over the sorted list head. Return NULL if allocation fails */
+skiplist_t *skip_new(struct list_head *head);
+
+/* Free the lanes, leaving the list alone */
+void skip_free(skiplist_t *s);
+
+/* Return the first node of the list whose string is not below str (strictly
+ * above it if after is set), or the header if none is.
+ */
+struct list_head *skip_search(skiplist_t *s, const char *str, bool after);
+
+/* Link element e into the list after the ones with strings up to its own, and
+ * give it a tower at random
+ */
+void skip_insert(skiplist_t *s, element_t *e);
+
+/* Take down the tower of element e, if it has one, before e leaves the list.
+ * Nothing is freed.
+ */
+void skip_remove(skiplist_t *s, element_t *e);
+
+#endif /* LAB0_SKIPLIST_H */
@@ -0,0 +1,78 @@
+#include <stdlib.h>
+
+/* The ring is shared by two threads, use regular malloc/free */
+#define INTERNAL 1
+#include "spsc.h"
+
+/* Create a ring of at least size slots */
+spsc_t *spsc_new(size_t size)
+{
+    size_t slots = 1;
+    while (slots < size)
+        slots <<= 1;
+
+    spsc_t *r = aligned_alloc(64, sizeof(spsc_t));
+    if (!r)
+        return NULL;
+    r->slot = malloc(slots * sizeof(element_t *));
+    if (!r->slot) {
+        free(r);
+        return NULL;
+    }
+    r->mask = slots - 1;
+    atomic_init(&r->head, 0);
+    atomic_init(&r->tail, 0);
+    r->tail_cache = r->head_cache = 0;
+    return r;
+}
+
+/* Free the ring */
+void spsc_free(spsc_t *r)
+{
+    if (!r)
+        return;
+    free(r->slot);
+    free(r);
+}
+
+/* Insert up to n elements, on the producer thread */
+size_t spsc_insert_n(spsc_t *r, element_t *const *e, size_t n)
+{
+    size_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    size_t room = r->mask + 1 - (tail - r->head_cache);
+    if (room < n) {
+        /* Pairs with the release store of spsc_remove_n(): slots freed are no
+         * longer read.
+         */
+        r->head_cache = atomic_load_explicit(&r->head, memory_order_acquire);
+        room = r->mask + 1 - (tail - r->head_cache);
+        if (room < n)
+            n = room;
+    }
+
+    for (size_t i = 0; i < n; i++)
+        r->slot[(tail + i) & r->mask] = e[i];
+    atomic_store_explicit(&r->tail, tail + n, memory_order_release);
+    return n;
+}
+
+/* Remove up to n elements, on the consumer thread */
+size_t spsc_remove_n(spsc_t *r, element_t **e, size_t n)
+{
+    size_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    size_t avail = r->tail_cache - head;
+    if (avail < n) {
+        /* Pairs with the release store of spsc_insert_n(): the slots were
+         * written.
+         */
+        r->tail_cache = atomic_load_explicit(&r->tail, memory_order_acquire);
+        avail = r->tail_cache - head;
+        if (avail < n)
+            n = avail;
+    }
+
+    for (size_t i = 0; i < n; i++)
+        e[i] = r->slot[(head + i) & r->mask];
+    atomic_store_explicit(&r->head, head + n, memory_order_release);
+    return n;
+}
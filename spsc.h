@@ -0,0 +1,63 @@
+#ifndef LAB0_SPSC_H
+#define LAB0_SPSC_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "queue.h"
+
+/* Bounded FIFO of queue elements between one producer thread and one consumer
+ * thread. Neither ever waits for the other: a full or empty ring makes the
+ * call return at once.
+ *
+ * The producer only writes @tail and the consumer only writes @head, each on a
+ * cache line of its own. Each keeps the last value it read of the other index,
+ * and reads it again only when that copy shows the ring full or empty. A batch
+ * of elements is published by a single release store of the index.
+ */
+
+/**
+ * spsc_t - Single-producer, single-consumer ring
+ * @mask: number of slots minus one, the number of slots being a power of two
+ * @slot: element pointers
+ * @head: number of elements removed so far, masked the slot of the next one
+ * @tail_cache: value of @tail last read by the consumer
+ * @tail: number of elements inserted so far, masked the next free slot
+ * @head_cache: value of @head last read by the producer
+ */
+typedef struct {
+    size_t mask;
+    element_t **slot;
+    _Alignas(64) _Atomic size_t head;
+    size_t tail_cache;
+    _Alignas(64) _Atomic size_t tail;
+    size_t head_cache;
+} spsc_t;
+
+/* Create a ring of at least size slots. Return NULL if allocation fails */
+spsc_t *spsc_new(size_t size);
+
+/* Free the ring. Elements left in it are not released */
+void spsc_free(spsc_t *r);
+
+/* Insert up to n elements of e, in order. Return how many fit */
+size_t spsc_insert_n(spsc_t *r, element_t *const *e, size_t n);
+
+/* Remove up to n elements into e, in order. Return how many there were */
+size_t spsc_remove_n(spsc_t *r, element_t **e, size_t n);
+
+/* Insert element e. Return false if the ring is full */
+static inline bool spsc_insert(spsc_t *r, element_t *e)
+{
+    return spsc_insert_n(r, &e, 1);
+}
+
+/* Remove an element. Return NULL if the ring is empty */
+static inline element_t *spsc_remove(spsc_t *r)
+{
+    element_t *e;
+    return spsc_remove_n(r, &e, 1) ? e : NULL;
+}
+
+#endif /* LAB0_SPSC_H */
@@ -0,0 +1,15 @@
+# Compare q_free: run once built with ARENA=1 and once without
+option fail 0
+option malloc 0
+new
+# trace-14-perf: ih dolphin 1000000
+time ih dolphin 1000000
+# trace-14-perf: it gerbil 1000000
+time it gerbil 1000000
+# free 2M elements
+time free
+new
+# ih RAND 1000000
+time ih RAND 1000000
+# free 1M elements
+time free
@@ -0,0 +1,40 @@
+# Compare queue backends: run once built with each of BACKEND=chunk, BACKEND=ring
+# and neither
+option fail 0
+option malloc 0
+# warm up the allocator
+new
+ih RAND 100000
+sort
+free
+# 10000 elements: insert at head and tail, walk, sort
+new
+time ih dolphin 5000
+time it gerbil 5000
+time show
+free
+new
+ih RAND 10000
+time sort
+time show
+free
+# 100000 elements: insert at head and tail, walk, sort
+new
+time ih dolphin 50000
+time it gerbil 50000
+time show
+free
+new
+ih RAND 100000
+time sort
+time show
+free
+# 1000000 elements: insert at head and tail, walk, sort
+new
+time ih dolphin 500000
+time it gerbil 500000
+time show
+time reverse
+time show
+time sort
+free
@@ -0,0 +1,19 @@
+# Insert and remove elements one call at a time, then with the bulk API which
+# links them together before attaching them to the queue at once, and detaches
+# them with one cut
+option fail 0
+option malloc 0
+option bulk 0
+new
+time ih RAND 1000000
+time it gerbil 1000000
+time rhn 1000000
+time rtn 1000000
+free
+option bulk 1
+new
+time ih RAND 1000000
+time it gerbil 1000000
+time rhn 1000000
+time rtn 1000000
+free
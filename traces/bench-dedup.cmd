@@ -0,0 +1,41 @@
+# Delete duplicates from 200000 random strings, 1%, 10% then 50% of which repeat
+# a recent one: by sorting the queue so they come together, then in place with
+# a hash table of the strings
+option verbose 2
+option fail 0
+option malloc 0
+option randdup 1
+new
+it RAND 200000
+time sort
+time dedup
+free
+option hashdedup 1
+new
+it RAND 200000
+time dedup
+free
+option hashdedup 0
+option randdup 10
+new
+it RAND 200000
+time sort
+time dedup
+free
+option hashdedup 1
+new
+it RAND 200000
+time dedup
+free
+option hashdedup 0
+option randdup 50
+new
+it RAND 200000
+time sort
+time dedup
+free
+option hashdedup 1
+new
+it RAND 200000
+time dedup
+free
@@ -0,0 +1,18 @@
+# Compare q_delete_mid: run once built with MID_FINGER=1 and once without
+option fail 0
+option malloc 0
+new
+ih RAND 200000
+# dm 100 on 200000 elements
+time dm 100
+# dm 100, inserting at both ends in between
+it RAND 1000
+ih RAND 1000
+time dm 100
+rh
+rt
+time dm 100
+# dm 100 after a reverse
+reverse
+time dm 100
+free
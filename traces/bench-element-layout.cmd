@@ -0,0 +1,25 @@
+# Compare element layouts: run once built with INLINE_STR=1 and once without
+option fail 0
+option malloc 0
+new
+# trace-14-perf: ih dolphin 1000000
+time ih dolphin 1000000
+# trace-14-perf: it gerbil 1000000
+time it gerbil 1000000
+# trace-14-perf: reverse
+time reverse
+# trace-14-perf: sort
+time sort
+# trace-14-perf: free
+time free
+new
+# trace-15-perf: ih RAND 100000
+time ih RAND 100000
+# trace-15-perf: sort
+time sort
+# trace-15-perf: reverse
+time reverse
+# trace-15-perf: sort
+time sort
+# trace-15-perf: free
+time free
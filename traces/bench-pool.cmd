@@ -0,0 +1,20 @@
+# Compare element allocation: run once built with POOL=1 and once without
+option fail 0
+option malloc 0
+new
+# ih RAND 1000000
+time ih RAND 1000000
+# it RAND 1000000
+time it RAND 1000000
+# free: releases every element, the same path as rh/rt
+time free
+new
+# ih dolphin 1000000 (refill after release)
+time ih dolphin 1000000
+# it gerbil 1000000
+time it gerbil 1000000
+# rh/rt on a 2M-element queue
+time rh dolphin
+time rt gerbil
+# free
+time free
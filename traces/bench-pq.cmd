@@ -0,0 +1,9 @@
+# Pop the smallest strings after each batch of inserts, through a pairing heap
+# and through a queue sorted after each batch, with small to large batches
+option fail 0
+option malloc 0
+option verbose 2
+pq 20000 16
+pq 20000 256
+pq 20000 4096
+pq 100000 4096
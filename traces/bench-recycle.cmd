@@ -0,0 +1,13 @@
+# Insert an element at tail and remove the head over and over, releasing each
+# element removed, then keeping up to 64 of them for the next inserts to reuse
+option fail 0
+option malloc 0
+new
+it gerbil 1000
+mem
+time churn gerbil 10000000
+mem
+option recycle 64
+time churn gerbil 10000000
+mem
+free
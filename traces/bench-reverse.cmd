@@ -0,0 +1,16 @@
+# Compare q_reverse: run once built with LAZY_REVERSE=1 and once without
+option fail 0
+option malloc 0
+new
+ih dolphin 1000000
+# reverse 1000000 elements
+time reverse
+time reverse
+# trace-15-perf: reverse, then sort
+free
+new
+ih RAND 200000
+sort
+time reverse
+time sort
+free
@@ -0,0 +1,27 @@
+# Find the median and the 99th percentile of random strings with select, which
+# partitions the queue in place, against sorting it first. Then select from
+# the sorted queue and from the reversed one, where median of three alone
+# would go quadratic.
+option verbose 2
+option fail 0
+option malloc 0
+new
+ih RAND 200000
+free
+new
+ih RAND 200000
+time sort
+free
+new
+ih RAND 200000
+time select 100000
+time select 198000
+time sort
+time select 100000
+reverse
+time select 100000
+free
+new
+ih RAND 1000000
+time select 500000
+free
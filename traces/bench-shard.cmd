@@ -0,0 +1,8 @@
+# Scaling of the sharded pool of shard.c from 1 to 32 threads: inserts into
+# each thread's own shard, removes with stealing, then an ordered drain
+shard 1
+shard 2
+shard 4
+shard 8
+shard 16
+shard 32
@@ -0,0 +1,47 @@
+# Insert random strings into a sorted queue with is, walking the queue from its
+# head, against searching the express lanes of a skip list over it. Then build
+# a sorted queue of 1000000 strings through the skip list, 50000 at a time,
+# and look up and remove strings in it.
+option verbose 2
+option fail 0
+option malloc 0
+new
+is RAND 2000
+is RAND 8000
+free
+option skiplist 1
+new
+is RAND 2000
+is RAND 8000
+free
+new
+is RAND 50000
+is RAND 50000
+is RAND 50000
+is RAND 50000
+is RAND 50000
+is RAND 50000
+is RAND 50000
+is RAND 50000
+is RAND 50000
+is RAND 50000
+is RAND 50000
+is RAND 50000
+is RAND 50000
+is RAND 50000
+is RAND 50000
+is RAND 50000
+is RAND 50000
+is RAND 50000
+is RAND 50000
+is RAND 50000
+is aaaa
+find aaaa
+rv aaaa
+find aaaa
+rh
+rt
+dm
+is aaaa 10
+size
+free
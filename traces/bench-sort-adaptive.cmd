@@ -0,0 +1,92 @@
+# Compare adaptive merge sort (option sort 2) with list_sort (option sort 0)
+option fail 0
+option malloc 0
+option verbose 2
+# Warm up the allocator so that every case sorts recycled elements
+new
+ih RAND 200000
+sort
+free
+new
+ih RAND 200000
+option sort 0
+# random input, list_sort
+time sort
+free
+new
+ih RAND 200000
+option sort 2
+# random input, adaptive merge sort
+time sort
+free
+new
+ih RAND 200000
+option sort 0
+sort
+option sort 0
+# already sorted input, list_sort
+time sort
+free
+new
+ih RAND 200000
+option sort 0
+sort
+option sort 2
+# already sorted input, adaptive merge sort
+time sort
+free
+new
+ih RAND 200000
+option sort 0
+sort
+reverse
+option sort 0
+# trace-15-perf: reversed input, list_sort
+time sort
+free
+new
+ih RAND 200000
+option sort 0
+sort
+reverse
+option sort 2
+# trace-15-perf: reversed input, adaptive merge sort
+time sort
+free
+new
+ih RAND 200000
+option sort 0
+sort
+ih RAND 50
+it RAND 50
+option sort 0
+# nearly sorted input (100 stragglers at both ends), list_sort
+time sort
+free
+new
+ih RAND 200000
+option sort 0
+sort
+ih RAND 50
+it RAND 50
+option sort 2
+# nearly sorted input (100 stragglers at both ends), adaptive merge sort
+time sort
+free
+new
+ih dolphin 1000000
+it gerbil 1000000
+reverse
+option sort 0
+# trace-14-perf: 2M elements, list_sort
+time sort
+free
+new
+ih dolphin 1000000
+it gerbil 1000000
+reverse
+option sort 2
+# trace-14-perf: 2M elements, adaptive merge sort
+time sort
+free
+option sort 0
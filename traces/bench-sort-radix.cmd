@@ -0,0 +1,37 @@
+# Compare MSD radix sort (option sort 3) with list_sort (option sort 0)
+option fail 0
+option malloc 0
+option verbose 2
+# Warm up the allocator so that every case sorts recycled elements
+new
+ih RAND 200000
+sort
+free
+option prefix 0
+new
+ih RAND 200000
+option sort 0
+# random strings, list_sort
+time sort
+free
+new
+ih RAND 200000
+option sort 3
+# random strings, radix sort
+time sort
+free
+option prefix 200
+new
+ih RAND 200000
+option sort 0
+# random strings sharing a 200-byte prefix, list_sort
+time sort
+free
+new
+ih RAND 200000
+option sort 3
+# random strings sharing a 200-byte prefix, radix sort
+time sort
+free
+option prefix 0
+option sort 0
@@ -0,0 +1,46 @@
+# Scaling of the parallel sort (option threads N) over 300000 random strings
+option fail 0
+option malloc 0
+option verbose 2
+# Warm up the allocator so that every case sorts recycled elements
+new
+ih RAND 150000
+ih RAND 150000
+sort
+free
+new
+ih RAND 150000
+ih RAND 150000
+option threads 1
+# 1 thread
+time sort
+free
+new
+ih RAND 150000
+ih RAND 150000
+option threads 2
+# 2 threads
+time sort
+free
+new
+ih RAND 150000
+ih RAND 150000
+option threads 4
+# 4 threads
+time sort
+free
+new
+ih RAND 150000
+ih RAND 150000
+option threads 8
+# 8 threads
+time sort
+free
+new
+ih RAND 150000
+ih RAND 150000
+option threads 16
+# 16 threads
+time sort
+free
+option threads 1
@@ -0,0 +1,44 @@
+# Sort then delete duplicates from random strings as in trace-15, 10% of which
+# repeat a recent one: with sort and dedup, walking the queue twice, then
+# with sortunique, which drops them in the final merge of the sort. A first
+# queue of each size warms the heap up, so that both runs get blocks reused.
+option verbose 2
+option fail 0
+option malloc 0
+option randdup 10
+new
+ih RAND 10000
+free
+new
+ih RAND 10000
+time sort
+time dedup
+free
+new
+ih RAND 10000
+time sortunique
+free
+new
+ih RAND 50000
+free
+new
+ih RAND 50000
+time sort
+time dedup
+free
+new
+ih RAND 50000
+time sortunique
+free
+new
+ih RAND 100000
+free
+new
+ih RAND 100000
+time sort
+time dedup
+free
+new
+ih RAND 100000
+time sortunique
+free
@@ -0,0 +1,45 @@
+# Compare list_sort (option sort 0) with top-down merge sort (option sort 1)
+option fail 0
+option malloc 0
+option verbose 2
+# random input, list_sort
+new
+ih RAND 200000
+option sort 0
+time sort
+# already sorted input, list_sort
+time sort
+# reversed input, list_sort
+reverse
+time sort
+free
+# random input, top-down merge sort
+new
+ih RAND 200000
+option sort 1
+time sort
+# already sorted input, top-down merge sort
+time sort
+# reversed input, top-down merge sort
+reverse
+time sort
+free
+# duplicate-heavy input, list_sort
+new
+ih gerbil 50000
+it dolphin 50000
+ih bear 50000
+it meerkat 50000
+option sort 0
+time sort
+free
+# duplicate-heavy input, top-down merge sort
+new
+ih gerbil 50000
+it dolphin 50000
+ih bear 50000
+it meerkat 50000
+option sort 1
+time sort
+free
+option sort 0
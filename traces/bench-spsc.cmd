@@ -0,0 +1,7 @@
+# Pass elements from one thread to another through the ring of spsc.c, and
+# through a queue behind a mutex, one at a time and in batches
+option fail 0
+option malloc 0
+spsc 1000000
+spsc 1000000 16
+spsc 1000000 256
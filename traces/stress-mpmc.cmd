@@ -0,0 +1,8 @@
+# Pass elements through the lock-free queue: each must come out once, and in
+# the order its producer inserted it
+mpmc 1 1
+mpmc 4 1
+mpmc 1 4
+mpmc 4 4
+mpmc 8 8 20000
+mpmc 31 32 2000
@@ -0,0 +1,59 @@
+# Test of insert_sorted, find and remove_value, walking the queue and with a
+# skip list, and of delete_mid after removing values from the middle
+option fail 0
+option malloc 0
+new
+it a
+it b
+it c
+it d
+it e
+it f
+it g
+it h
+dm
+rv b
+dm
+rh a
+rh c
+rh d
+rh g
+rh h
+is gerbil
+is bear
+is meerkat
+is dolphin
+is bear
+find bear
+find tiger
+rv dolphin
+rv tiger
+dm
+rh bear
+rh bear
+rh meerkat
+option skiplist 1
+is gerbil
+is bear
+is meerkat
+is dolphin
+is bear
+is tiger
+find meerkat
+rv meerkat
+dm
+rt tiger
+rh bear
+rh bear
+rh gerbil
+it zebra
+ih yak
+reverse
+sort
+is vulture
+is squirrel
+rv vulture
+dm
+rh squirrel
+rh zebra
+free
@@ -0,0 +1,28 @@
+# Test of the pairing heap: removals come smallest first, duplicates included,
+# with inserts and removals interleaved
+option fail 0
+option malloc 0
+pqi gerbil
+pqi bear
+pqi dolphin
+pqi meerkat
+pqi bear
+pqr bear
+pqr bear
+pqi aardvark
+pqi tiger
+pqr aardvark
+pqr dolphin
+pqi zebra 3
+pqi cat
+pqr cat
+pqr gerbil
+pqr meerkat
+pqr tiger
+pqr zebra
+pqr zebra
+pqr zebra
+pqi RAND 1000
+pqr
+pqr
+pqr